@@ -26,6 +26,8 @@
 #include <vector>
 
 #include "Tlc5940.h"
+#include <EEPROM.h>
+#include <avr/sleep.h>
 
 #include "typedefs.h"
 #include "midiutils.h"
@@ -33,6 +35,14 @@
 #include "envelopegenerator.h"
 #include "lfogenerator.h"
 #include "pitchgenerator.h"
+#include "pitchcalibration.h"
+#include "parametersources.h"
+#include "trace.h"
+#include "idlemonitor.h"
+#include "modmatrix.h"
+#include "ramwatch.h"
+#include "dotcorrection.h"
+#include "eepromlayout.h"
 
 //TLC pins
 #define vcoATlcPin  0
@@ -73,14 +83,18 @@
 
 #define _NOP() do { __asm__ __volatile__ ("nop"); } while (0)
 
-//lfogenerator object
-LfoGenerator gLfoA;
-bool gLfoSineOrSquare;
+//lfogenerator objects. gLfoA is the one on the panel
+LfoBank gLfoBank;
+LfoGenerator &gLfoA = gLfoBank.mLfos[0];
 
 //mod amount
 int gModWheelScaled = 0;
+//unison detune depth from CONTROL_UNISON_SPREAD, 0 - 127
+uint8_t gUnisonSpread = 0;
 // pitch bend
 int gPitchBendScaled = 0;
+long gPitchBendRaw = 0;     //-8192 to 8191
+uint8_t gPitchBendRange = pitchBendRangeDefault;
 
 //pitchgenerator objects for vco
 PitchGenerator gPitchA;
@@ -90,6 +104,27 @@ PitchGenerator gPitchD;
 PitchGenerator gPitchE;
 PitchGenerator gPitchF;
 
+//per voice tuning on top of gTlcValues, loaded from EEPROM in setup()
+PitchCalibration gPitchCalibration;
+
+//knob, CC or preset for each sound parameter
+ParameterSources gParameters;
+//the mux B channel of each parameter's knob, in PARAMETERS order
+const uint8_t gParameterKnobs[NUM_PARAMS] = {KNB_ATTACK_CHAN, KNB_DECAY_CHAN, KNB_SUSTAIN_CHAN, KNB_RELEASE_CHAN,
+    KNB_GLIDE_CHAN, KNB_MOD_FRQ_CHAN, KNB_MOD_VCF_AMT_CHAN, KNB_MOD_VCO_AMT_CHAN};
+
+//sleeps through the gaps between notes
+IdleMonitor gIdle;
+
+//where the LFO, mod wheel and the rest go
+ModMatrix gModMatrix;
+
+//how much of the 2 KB the heap and stack have had
+RamWatch gRamWatch;
+
+//per channel TLC level trim, loaded from EEPROM in setup()
+DotCorrection gDotCorrection;
+
 uint8_t gVcoAMidiValue = 0;
 uint8_t gVcoBMidiValue = 0;
 uint8_t gVcoCMidiValue = 0;
@@ -119,6 +154,12 @@ unsigned int gVcaDtlcValue = 0;
 unsigned int gVcaEtlcValue = 0;
 unsigned int gVcaFtlcValue = 0;
 
+//the same voices by number, for MPE where the voice is only known at run time
+EnvelopeGenerator *const gEnvelopes[NUM_VOICES] = {&gEnvelopeA, &gEnvelopeB, &gEnvelopeC, &gEnvelopeD, &gEnvelopeE, &gEnvelopeF};
+PitchGenerator *const gPitches[NUM_VOICES] = {&gPitchA, &gPitchB, &gPitchC, &gPitchD, &gPitchE, &gPitchF};
+uint8_t *const gVcoMidiValues[NUM_VOICES] = {&gVcoAMidiValue, &gVcoBMidiValue, &gVcoCMidiValue, &gVcoDMidiValue, &gVcoEMidiValue, &gVcoFMidiValue};
+unsigned int *const gVcaTlcValues[NUM_VOICES] = {&gVcaAtlcValue, &gVcaBtlcValue, &gVcaCtlcValue, &gVcaDtlcValue, &gVcaEtlcValue, &gVcaFtlcValue};
+
 bool gMidiIsReady = false;
 bool gTlcNeedsUpdate = false;
 
@@ -195,6 +236,7 @@ void addToAssignmentPoly(std::vector<PolyNoteInfo> &lVec, unsigned int &lNumAssi
         {
             if(lVec[lAssignmentIndex].note == 0)
             {
+                TRACE(TRACE_VOICE_ASSIGN, lAssignmentIndex, gMidiState.newNote);
                 lVec[lAssignmentIndex].note = gMidiState.newNote;
                 lVec[lAssignmentIndex].doAttack = true;
                 lVec[lAssignmentIndex].doRelease = false;
@@ -237,7 +279,7 @@ void addToAssignmentPoly(std::vector<PolyNoteInfo> &lVec, unsigned int &lNumAssi
                 }
             }
         }
-        // Serial.print("stealing: "); Serial.println(lVec[lStealIndex].note, DEC);
+        TRACE(TRACE_VOICE_STEAL, lStealIndex, lVec[lStealIndex].note);
 
         lVec[lStealIndex].note = gMidiState.newNote;
         lVec[lStealIndex].doAttack = true;
@@ -276,6 +318,7 @@ bool removeFromAssignmentPoly(std::vector<PolyNoteInfo> &lVec, int lNumOsc)
     {
         if(gOscillatorAssignmentPoly[lAssignmentIndex].note == gMidiState.newNote)
         {
+            TRACE(TRACE_VOICE_FREE, lAssignmentIndex, gMidiState.newNote);
             gOscillatorAssignmentPoly[lAssignmentIndex].doRelease = true;
             lSuccessfulRemoval =  true;
         }
@@ -283,22 +326,200 @@ bool removeFromAssignmentPoly(std::vector<PolyNoteInfo> &lVec, int lNumOsc)
     return lSuccessfulRemoval;
 }
 
+/********************************************************************************************************
+applyDotCorrection()
+puts gDotCorrection's trims into the TLC, or into the envelopes' full level if the TLC's register can't be written
+********************************************************************************************************/
+void applyDotCorrection()
+{
+#if VPRG_ENABLED
+    gDotCorrection.apply();
+#else
+    for(uint8_t lVoice = 0; lVoice < NUM_VOICES; lVoice++)
+    {
+        gEnvelopes[lVoice]->mTlcScalar = gDotCorrection.envelopeScalar(vcaATlcPin + lVoice);
+    }
+#endif
+}
+
+/********************************************************************************************************
+handleSysexData() / handleSysexEnd()
+called by the parser in midiutils.h for our own system exclusive messages
+********************************************************************************************************/
+void handleSysexData(uint8_t lCommand, uint8_t lIndex, uint8_t lByte)
+{
+    switch(lCommand)
+    {
+        case SYSEX_PITCH_CALIBRATION:
+            gPitchCalibration.uploadByte(lIndex, lByte);
+            break;
+        case SYSEX_PARAMETER_CC:
+        case SYSEX_PRESET_SAVE:
+            gParameters.sysexByte(lIndex, lByte);
+            break;
+        case SYSEX_MOD_ROUTE:
+            gModMatrix.sysexByte(lIndex, lByte);
+            break;
+        case SYSEX_DOT_CORRECTION:
+            gDotCorrection.sysexByte(lIndex, lByte);
+            break;
+        default:
+            break;
+    }
+}
+
+void handleSysexEnd(uint8_t lCommand, uint8_t lPayloadLength, bool lIsComplete)
+{
+    switch(lCommand)
+    {
+        case SYSEX_PITCH_CALIBRATION:
+            gPitchCalibration.endUpload(lPayloadLength, lIsComplete);
+            break;
+        case SYSEX_PARAMETER_CC:
+            gParameters.endMapCc(lPayloadLength, lIsComplete);
+            break;
+        case SYSEX_PRESET_SAVE:
+            gParameters.endSavePreset(lPayloadLength, lIsComplete);
+            break;
+        case SYSEX_IDLE_REPORT:
+            gIdle.sendReport();
+            break;
+        case SYSEX_MOD_ROUTE:
+            gModMatrix.endSetRoute(lPayloadLength, lIsComplete);
+            break;
+        case SYSEX_RAM_REPORT:
+            gRamWatch.sendReport();
+            break;
+        case SYSEX_DOT_CORRECTION:
+            if(gDotCorrection.endSetTrim(lPayloadLength, lIsComplete))
+            {
+                applyDotCorrection();
+            }
+            break;
+#if TRACE_ENABLED
+        case SYSEX_TRACE_DUMP:
+            gTraceFlushRequested = true;
+            break;
+#endif
+        default:
+            break;
+    }
+}
+
+/********************************************************************************************************
+updateUnisonDetune()
+spreads the oscillators that play the same note in the stacked modes. each voice's place in its stack is
+-127 to 127 and a full spread puts the outside ones UNISON_SPREAD_MAX apart each way. the pitch generators
+turn that into TLC counts once per note, so nothing happens here unless the mode or the spread moved
+********************************************************************************************************/
+#define UNISON_SPREAD_MAX 64     //in pitchBendIncrements, so half a semitone
+
+const PROGMEM int8_t gUnisonPositions[POLY_MPE + 1][NUM_VOICES] = {
+    {0, 0, 0, 0, 0, 0},                 //MONO_1
+    {-127, 127, 0, 0, 0, 0},            //MONO_2
+    {-127, 0, 127, 0, 0, 0},            //MONO_3
+    {-127, -76, -25, 25, 76, 127},      //MONO_6
+    {0, 0, 0, 0, 0, 0},                 //POLY_1
+    {-127, 127, -127, 127, -127, 127},  //POLY_2, A B / C D / E F
+    {-127, 0, 127, -127, 0, 127},       //POLY_3, A B C / D E F
+    {0, 0, 0, 0, 0, 0}                  //POLY_MPE
+};
+
+void updateUnisonDetune()
+{
+    static POLYPHONY lMode = MONO_1;
+    static uint8_t lSpread = 0;
+    if(gPolyphonyStatus == lMode && gUnisonSpread == lSpread)
+    {
+        return;
+    }
+    lMode = gPolyphonyStatus;
+    lSpread = gUnisonSpread;
+    for(uint8_t lVoice = 0; lVoice < NUM_VOICES; lVoice++)
+    {
+        int lPosition = static_cast<int8_t>(pgm_read_byte_near(&gUnisonPositions[lMode][lVoice]));
+        gPitches[lVoice]->setDetune(static_cast<long>(lPosition) * lSpread * UNISON_SPREAD_MAX / (127L * 127));
+    }
+}
+
+bool allVoicesOff()
+{
+    return gEnvelopeA.mAdsrStatus == OFF_STATE && gEnvelopeB.mAdsrStatus == OFF_STATE &&
+        gEnvelopeC.mAdsrStatus == OFF_STATE && gEnvelopeD.mAdsrStatus == OFF_STATE &&
+        gEnvelopeE.mAdsrStatus == OFF_STATE && gEnvelopeF.mAdsrStatus == OFF_STATE;
+}
+
+/********************************************************************************************************
+releaseVoices()
+bit per voice, from MpeZone
+********************************************************************************************************/
+void releaseVoices(uint8_t lVoices)
+{
+    for(uint8_t lVoice = 0; lVoice < NUM_VOICES; lVoice++)
+    {
+        if((lVoices & (1 << lVoice)) && gEnvelopes[lVoice]->mAdsrStatus != OFF_STATE)
+        {
+            TRACE(TRACE_VOICE_FREE, lVoice, *gVcoMidiValues[lVoice]);
+            gEnvelopes[lVoice]->setAdsrState(RELEASE_STATE);
+        }
+    }
+}
+
 void doMidiStates()
 {
     if(gMidiState.parseStatus == DONE)
     {
+        /****************************************Handle SysEx**********************************************/
+        if(gMidiState.status == SYSTEM_EXCLUSIVE)
+        {
+            handleSysexEnd(gMidiState.sysexCommand, gMidiState.sysexLength - 2, gMidiState.sysexIsComplete);
+            gMidiState.parseStatus = STATUS;
+            return;
+        }
+
         /****************************************Handle MIDI notes*****************************************/
         if(gMidiState.status == NOTE_ON)
         {
+            TRACE(TRACE_NOTE_ON, gMidiState.newNote, gMidiState.velocity);
             addToNotesPressed(gMidiState.newNote);
         }
         else if(gMidiState.status == NOTE_OFF)
         {
+            TRACE(TRACE_NOTE_OFF, gMidiState.newNote, 0);
             removeFromNotesPressed(gMidiState.newNote);
         }
+        else if(gMidiState.status == CONTROL && gMidiState.controlStatus == SUSTAIN_PEDAL)
+        {
+            TRACE(TRACE_SUSTAIN, gMidiState.sustainIsOn, 0);
+        }
         switch(gPolyphonyStatus)
         {
             /*************************************************Polyphonic Section************************************************************/
+            case POLY_MPE:
+            {
+                // one voice per note, picked by gMpe. the channel's bend and pressure follow it around in loop()
+                if(gMidiState.status == NOTE_ON && (gMidiState.newNote >= lowestMidi && gMidiState.newNote <= highestMidi))
+                {
+                    uint8_t lVoice = gMpe.noteOn(gMidiState.channel, gMidiState.newNote);
+                    TRACE(TRACE_VOICE_ASSIGN, lVoice, gMidiState.newNote);
+                    *gVcoMidiValues[lVoice] = gMidiState.newNote;
+                    gEnvelopes[lVoice]->setVelocity(gMidiState.velocity);
+                    gEnvelopes[lVoice]->setAdsrState(ATTACK_STATE);
+                }
+                else if(gMidiState.status == NOTE_OFF)
+                {
+                    uint8_t lVoice = gMpe.noteOff(gMidiState.channel, gMidiState.newNote, gMidiState.sustainIsOn);
+                    if(lVoice != MPE_NONE)
+                    {
+                        releaseVoices(1 << lVoice);
+                    }
+                }
+                else if(gMidiState.status == CONTROL && gMidiState.controlStatus == SUSTAIN_PEDAL && !gMidiState.sustainIsOn)
+                {
+                    releaseVoices(gMpe.sustainOff());
+                }
+                break;
+            }
             case POLY_3:
             {
                 static unsigned int lNumAssigned = 0;
@@ -803,8 +1024,34 @@ void doMidiStates()
         /**************************************Handle Pitch Bend*******************************************/
         if(gMidiState.status == PITCH_BEND)
         {
-            long int rawSigned = gMidiState.pitchBendLSB | (gMidiState.pitchBendMSB << 7);    //0 - 8192 - 16383
-            gPitchBendScaled = ((rawSigned * pitchBendIncrements) / 8191) - pitchBendIncrements; //-8192 to  8191 ) to -100 +100, whatever pitchBendIncrements is
+            gPitchBendRaw = static_cast<long>(gMidiState.pitchBendLSB | (gMidiState.pitchBendMSB << 7)) - 8192;    //0 - 8192 - 16383 to -8192 - 0 - 8191
+            gPitchBendScaled = (gPitchBendRaw * gPitchBendRange * pitchBendIncrements) >> 13;   // 8192 is 2^13. full wheel is gPitchBendRange semitones
+        }
+
+        /**************************************Handle Pitch Bend Range*************************************/
+        // on a member channel it's the range of every member
+        bool lFromManager = (gMidiState.channel == gMidiChannelNumber);
+        if(gMidiState.status == CONTROL && gMidiState.controlStatus == DATA_ENTRY &&
+            gMidiState.rpnMSB == RPN_PITCH_BEND_RANGE && gMidiState.rpnLSB == RPN_PITCH_BEND_RANGE && !lFromManager)
+        {
+            gMpe.setBendRange(gMidiState.dataEntry);
+        }
+        else if(gMidiState.status == CONTROL && gMidiState.controlStatus == DATA_ENTRY &&
+            gMidiState.rpnMSB == RPN_PITCH_BEND_RANGE && gMidiState.rpnLSB == RPN_PITCH_BEND_RANGE)
+        {
+            gPitchBendRange = gMidiState.dataEntry;
+            gPitchBendRange = gPitchBendRange < 1 ? 1 : gPitchBendRange;
+            gPitchBendRange = gPitchBendRange > pitchBendRangeMax ? pitchBendRangeMax : gPitchBendRange;
+            gPitchBendScaled = (gPitchBendRaw * gPitchBendRange * pitchBendIncrements) >> 13;
+        }
+
+        /**************************************Handle MPE Configuration***********************************/
+        // whatever was playing was given its voice by the other allocator, so let it all go
+        if(gMidiState.status == CONTROL && gMidiState.controlStatus == DATA_ENTRY && lFromManager &&
+            gMidiState.rpnMSB == 0 && gMidiState.rpnLSB == RPN_MPE_CONFIGURATION)
+        {
+            gMpe.configure(gMidiChannelNumber, gMidiState.dataEntry);
+            releaseVoices(gMpe.releaseAll() | ((1 << NUM_VOICES) - 1));
         }
 
         /**************************************Handle Mod Wheel*******************************************/
@@ -813,9 +1060,43 @@ void doMidiStates()
             // store this as in a global
             //gModWheelScaled needs to be between 0 to 1023
             gModWheelScaled = gMidiState.modulation << 3; //127 * 8 = 1016
+            gModMatrix.setSource(MOD_SRC_WHEEL, MOD_GLOBAL, gMidiState.modulation);
             // Serial.println(gModWheelScaled, DEC);
         }
 
+        /**************************************Handle Unison Spread***************************************/
+        if(gMidiState.status == CONTROL && lFromManager && gMidiState.controlNumber == CONTROL_UNISON_SPREAD)
+        {
+            gUnisonSpread = gMidiState.controlValue;
+        }
+
+        /**************************************Handle LFO Phase*******************************************/
+        if(gMidiState.status == CONTROL && lFromManager && gMidiState.controlNumber == CONTROL_LFO_PHASE_SPREAD)
+        {
+            gLfoA.setVoicePhaseSpread(gMidiState.controlValue * LFO_PHASE_SPREAD_PER_STEP);
+        }
+        if(gMidiState.status == CONTROL && lFromManager && gMidiState.controlNumber == CONTROL_LFO_KEY_SYNC)
+        {
+            gLfoA.setKeySync(gMidiState.controlValue > 0x3F);
+        }
+
+        /**************************************Handle Parameter CCs and Presets****************************/
+        if(gMidiState.status == CONTROL && lFromManager)
+        {
+            gParameters.handleControl(gMidiState.controlNumber, gMidiState.controlValue);
+        }
+        if(gMidiState.status == PROGRAM_CHANGE && lFromManager)
+        {
+            if(gMidiState.program == PRESET_PANEL_PROGRAM)
+            {
+                gParameters.useAllKnobs();
+            }
+            else
+            {
+                gParameters.loadPreset(gMidiState.program);
+            }
+        }
+
         // this is where we process the midi mesages to see what to do with them in the instrument
         // this would be a good place to handle all the midi statuses
         // pitch bend - LSB - MSB               updates synthstate
@@ -839,7 +1120,13 @@ ISR(TIMER0_COMPA_vect){
     // }
     // digitalWrite(debugLedPin, WRITETODEBUG);
     
-    gLfoA.calculateModulation(gLfoSineOrSquare);
+    gIdle.tick();
+    // nothing is sounding while quiescent, so the LFO can wait where it is
+    if(gIdle.mState == IDLE_ACTIVE)
+    {
+        gLfoBank.calculateModulation();
+    }
+    TRACE_TICK();
 
     sei();
 }
@@ -853,6 +1140,22 @@ void setup()
 {
     //Init PolyNoteInfo for polyphonic oscillator assignment struct
     initOscillatorAssignmentPoly();
+
+    gEnvelopeA.setVoice(0);
+    gEnvelopeB.setVoice(1);
+    gEnvelopeC.setVoice(2);
+    gEnvelopeD.setVoice(3);
+    gEnvelopeE.setVoice(4);
+    gEnvelopeF.setVoice(5);
+
+    // per voice pitch calibration. voices stay on the plain table if nothing has been uploaded yet
+    gPitchCalibration.loadFromEeprom();
+    gPitchA.setCalibration(gPitchCalibration.mOffsets[0]);
+    gPitchB.setCalibration(gPitchCalibration.mOffsets[1]);
+    gPitchC.setCalibration(gPitchCalibration.mOffsets[2]);
+    gPitchD.setCalibration(gPitchCalibration.mOffsets[3]);
+    gPitchE.setCalibration(gPitchCalibration.mOffsets[4]);
+    gPitchF.setCalibration(gPitchCalibration.mOffsets[5]);
     
     //switch mux
     pinMode(muxA_S0, OUTPUT);
@@ -886,6 +1189,10 @@ void setup()
 
     Tlc.init();
 
+    // VCA level matching. channels stay at full level if nothing has been saved yet
+    gDotCorrection.loadFromEeprom();
+    applyDotCorrection();
+
     //turn off oscillators.. does this prevent boot up scream from happening?
     // set VCOs
     Tlc.set(vcoATlcPin, 0);
@@ -905,8 +1212,59 @@ void setup()
     Serial.begin(31250);
 }
 
+/********************************************************************************************************
+sleepWhileQuiescent()
+sleeps until an interrupt, then decides whether to wake up properly.
+returns true if loop() should carry on
+********************************************************************************************************/
+bool sleepWhileQuiescent()
+{
+    // a byte that landed after the last check would otherwise sit there until the next TIMER0 tick.
+    // sleep_cpu() straight after sei() always runs before a pending interrupt is taken
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    cli();
+    if(!Serial.available())
+    {
+        sleep_enable();
+        sei();
+        sleep_cpu();
+        sleep_disable();
+    }
+    // the RX interrupt that woke us returns here, so this is as close to the byte as the sketch gets
+    uint16_t lWokeAt = gIdle.stamp();
+    sei();
+
+    if(Serial.available())
+    {
+        gIdle.wake(IDLE_WAKE_MIDI, lWokeAt);
+        return true;
+    }
+    if(gIdle.checkDue())
+    {
+        int lKnobs[NUM_PARAMS];
+        for(uint8_t lParam = 0; lParam < NUM_PARAMS; lParam++)
+        {
+            lKnobs[lParam] = analogReadFromMux(muxB_S0, muxB_S1, muxB_S2, muxB_Input, gParameterKnobs[lParam]);
+        }
+        if(gIdle.knobsMoved(lKnobs))
+        {
+            gIdle.wake(IDLE_WAKE_PANEL, gIdle.tickStamp());
+            return true;
+        }
+    }
+    return false;
+}
+
 void loop()
 {
+    if(gIdle.mState == IDLE_QUIESCENT && !sleepWhileQuiescent())
+    {
+        return;
+    }
+    gRamWatch.update();
+    // saves go into EEPROM a cell at a time, see eepromlayout.h
+    gEepromWriter.update();
+
     // midi channel selection
     // do NOT change midi channel while holding down a note! 
     // your note will keep playing because the NOTE_OFF message is on a different channel
@@ -916,6 +1274,9 @@ void loop()
         !digitalReadFromMux(muxC_S0, muxC_S1, muxC_S2, muxC_Input, SW_MIDICHAN_BIT1_CHAN) * 4 + \
         !digitalReadFromMux(muxC_S0, muxC_S1, muxC_S2, muxC_Input, SW_MIDICHAN_BIT0_CHAN) * 8;
 
+#if TRACE_ENABLED
+    POLYPHONY lPreviousPolyphony = gPolyphonyStatus;
+#endif
     // do this only if no notes are pressed.
     if((gEnvelopeA.mAdsrStatus == RELEASE_STATE || gEnvelopeA.mAdsrStatus == OFF_STATE) &&
         (gEnvelopeB.mAdsrStatus == RELEASE_STATE || gEnvelopeB.mAdsrStatus == OFF_STATE) &&
@@ -924,7 +1285,12 @@ void loop()
         (gEnvelopeE.mAdsrStatus == RELEASE_STATE || gEnvelopeE.mAdsrStatus == OFF_STATE) &&
         (gEnvelopeF.mAdsrStatus == RELEASE_STATE || gEnvelopeF.mAdsrStatus == OFF_STATE))
     {
-        if(!digitalReadFromMux(muxA_S0, muxA_S1, muxA_S2, muxA_Input, SW_MONO_POLY_CHAN))
+        if(gMpe.isEnabled())
+        {
+            // an MPE zone takes all six voices whatever the switches say
+            gPolyphonyStatus = POLY_MPE;
+        }
+        else if(!digitalReadFromMux(muxA_S0, muxA_S1, muxA_S2, muxA_Input, SW_MONO_POLY_CHAN))
         {
             // if digitalRead is 0, we are in poly
             if(!digitalReadFromMux(muxA_S0, muxA_S1, muxA_S2, muxA_Input, SW_1OSC_1OSC_CHAN))
@@ -975,39 +1341,95 @@ void loop()
         }
     }
 
+#if TRACE_ENABLED
+    if(gPolyphonyStatus != lPreviousPolyphony)
+    {
+        TRACE(TRACE_POLYPHONY, gPolyphonyStatus, 0);
+    }
+#endif
+
     checkMidi();
     getMidiStates();
+    gIdle.resumed();
     doMidiStates();
+    updateUnisonDetune();
+
+    // only the knobs that are driving a parameter get read. the rest come from CCs or a preset
+    for(uint8_t lParam = 0; lParam < NUM_PARAMS; lParam++)
+    {
+        if(gParameters.wantsKnob(lParam))
+        {
+            gParameters.setKnobReading(lParam, analogReadFromMux(muxB_S0, muxB_S1, muxB_S2, muxB_Input, gParameterKnobs[lParam]));
+        }
+    }
+    gParameters.endScan();
+
+    // the envelopes, glide and CV all stand still once every voice is OFF, so after a while of that go to sleep.
+    // the knobs that aren't being scanned keep their last reading, which is good enough to spot a hand on the panel
+    if(gIdle.updateActive(allVoicesOff() && gMidiBuffer.isEmpty() && !Serial.available() && !gTlcNeedsUpdate &&
+        !gEepromWriter.isBusy(),
+        gParameters.mKnobReading))
+    {
+        for(uint8_t lParam = 0; lParam < NUM_PARAMS; lParam++)
+        {
+            gIdle.mKnobSnapshot[lParam] = analogReadFromMux(muxB_S0, muxB_S1, muxB_S2, muxB_Input, gParameterKnobs[lParam]);
+        }
+        return;
+    }
 
     // get LFO, knob values. I don't think I need to disable interrupts; these values are just being read from by one consumer
     // cli();
 
-    int gKnobLfoFrequency =  calculateLogFromLinear(analogReadFromMux(muxB_S0, muxB_S1, muxB_S2, muxB_Input, KNB_MOD_FRQ_CHAN));
-    int gModWheelScaledInLog = calculateLogFromLinear(gModWheelScaled);
-    int gLfoRecordLengthReading = (!digitalReadFromMux(muxC_S0, muxC_S1, muxC_S2, muxC_Input, SW_MIDI_MODWHEEL_ROUTE_FREQ_CHAN)) ?  max(gKnobLfoFrequency, gModWheelScaledInLog): gKnobLfoFrequency;
-    int gKnobLfoVcfAmount = analogReadFromMux(muxB_S0, muxB_S1, muxB_S2, muxB_Input, KNB_MOD_VCF_AMT_CHAN);
-    int gKnobLfoVcoAmount = analogReadFromMux(muxB_S0, muxB_S1, muxB_S2, muxB_Input, KNB_MOD_VCO_AMT_CHAN);
+    // the panel's routes in the mod matrix. the mod wheel switches turn a route up to at least the wheel
+    int gKnobLfoVcfAmount = gParameters.mValue[PARAM_LFO_VCF];
+    int gKnobLfoVcoAmount = gParameters.mValue[PARAM_LFO_VCO];
     int gLfoVcfAmplitudeReading = (!digitalReadFromMux(muxC_S0, muxC_S1, muxC_S2, muxC_Input, SW_MIDI_MODWHEEL_ROUTE_VCF_AMT_CHAN)) ?  max(gKnobLfoVcfAmount, gModWheelScaled): gKnobLfoVcfAmount;
     int gLfoVcoAmplitudeReading = (!digitalReadFromMux(muxC_S0, muxC_S1, muxC_S2, muxC_Input, SW_MIDI_MODWHEEL_ROUTE_VCO_AMT_CHAN)) ?  max(gKnobLfoVcoAmount, gModWheelScaled): gKnobLfoVcoAmount;
-    
-    
-    gLfoA.setLfoRecordLength(gLfoRecordLengthReading);
-    gLfoA.setLfoVcfScalar(gLfoVcfAmplitudeReading);
-    gLfoA.setLfoVcoScalar(gLfoVcoAmplitudeReading);
-    gLfoSineOrSquare = digitalReadFromMux(muxA_S0, muxA_S1, muxA_S2, muxA_Input, SW_MOD_SINE_SQUARE_CHAN);
+    bool lModWheelToFrequency = !digitalReadFromMux(muxC_S0, muxC_S1, muxC_S2, muxC_Input, SW_MIDI_MODWHEEL_ROUTE_FREQ_CHAN);
+    gModMatrix.setDepth(MOD_ROUTE_PANEL_VCO, gLfoVcoAmplitudeReading >> 3);
+    gModMatrix.setDepth(MOD_ROUTE_PANEL_VCF, -(gLfoVcfAmplitudeReading >> 3));
+    gModMatrix.setDepth(MOD_ROUTE_PANEL_FREQ, lModWheelToFrequency ? MOD_DEPTH_MAX : 0);
+    gModMatrix.setDepth(MOD_ROUTE_MPE_PRESSURE, gPolyphonyStatus == POLY_MPE ? MOD_DEPTH_MAX : 0);
+
+    // the sources that move on their own. a source that hasn't changed since last loop costs a compare
+    uint8_t lMaxPressure = 0;
+    for(uint8_t lVoice = 0; lVoice < NUM_VOICES; lVoice++)
+    {
+        uint8_t lPressure = gMpe.voicePressure(lVoice);
+        lMaxPressure = lPressure > lMaxPressure ? lPressure : lMaxPressure;
+        gModMatrix.setSource(MOD_SRC_LFO, lVoice, gLfoA.mVoiceWave[lVoice]);
+        gModMatrix.setSource(MOD_SRC_VELOCITY, lVoice, gEnvelopes[lVoice]->mVelocity);
+        gModMatrix.setSource(MOD_SRC_PRESSURE, lVoice, lPressure);
+    }
+    gModMatrix.setSource(MOD_SRC_LFO, MOD_GLOBAL, gLfoA.mWave);
+    gModMatrix.setSource(MOD_SRC_VELOCITY, MOD_GLOBAL, gMidiState.velocity);
+    gModMatrix.setSource(MOD_SRC_PRESSURE, MOD_GLOBAL, lMaxPressure);
+    gModMatrix.update();
+
+    // log(max()) is the same as max(log()), so the rate only takes the one log
+    int gLfoRecordLengthReading = max(gParameters.mValue[PARAM_LFO_FREQ], gModMatrix.output(MOD_DST_LFO_RATE, MOD_GLOBAL) << 3);
+    gLfoA.setLfoRecordLength(calculateLogFromLinear(gLfoRecordLengthReading));
+    gLfoA.setSineOrSquare(digitalReadFromMux(muxA_S0, muxA_S1, muxA_S2, muxA_Input, SW_MOD_SINE_SQUARE_CHAN));
     // sei();
 
-    // MOD to Oscillator switch
-    int gPitchToSet = gPitchBendScaled + static_cast<int>(gLfoA.mLfoVcoScalarOutput * 100);
-    gPitchA.mPitchAndLfoBend = gPitchToSet;
-    gPitchB.mPitchAndLfoBend = gPitchToSet;
-    gPitchC.mPitchAndLfoBend = gPitchToSet;
-    gPitchD.mPitchAndLfoBend = gPitchToSet;
-    gPitchE.mPitchAndLfoBend = gPitchToSet;
-    gPitchF.mPitchAndLfoBend = gPitchToSet;
+    // each voice has its own LFO phase. a full route is one semitone no matter what the bend range is
+    gPitchA.mPitchAndLfoBend = gPitchBendScaled + gModMatrix.output(MOD_DST_PITCH, 0);
+    gPitchB.mPitchAndLfoBend = gPitchBendScaled + gModMatrix.output(MOD_DST_PITCH, 1);
+    gPitchC.mPitchAndLfoBend = gPitchBendScaled + gModMatrix.output(MOD_DST_PITCH, 2);
+    gPitchD.mPitchAndLfoBend = gPitchBendScaled + gModMatrix.output(MOD_DST_PITCH, 3);
+    gPitchE.mPitchAndLfoBend = gPitchBendScaled + gModMatrix.output(MOD_DST_PITCH, 4);
+    gPitchF.mPitchAndLfoBend = gPitchBendScaled + gModMatrix.output(MOD_DST_PITCH, 5);
+    // with MPE each voice also follows the bend of the member channel playing it
+    if(gPolyphonyStatus == POLY_MPE)
+    {
+        for(uint8_t lVoice = 0; lVoice < NUM_VOICES; lVoice++)
+        {
+            gPitches[lVoice]->mPitchAndLfoBend += gMpe.voiceBend(lVoice);
+        }
+    }
 
     // pitch glide settings
-    int mGlideLengthReading = analogReadFromMux(muxB_S0, muxB_S1, muxB_S2, muxB_Input, KNB_GLIDE_CHAN);
+    int mGlideLengthReading = gParameters.mValue[PARAM_GLIDE];
     gPitchA.setGlideLength(mGlideLengthReading);
     gPitchB.setGlideLength(mGlideLengthReading);
     gPitchC.setGlideLength(mGlideLengthReading);
@@ -1022,12 +1444,17 @@ void loop()
     gPitchE.setLegatoOnlyGlide(lConstantOrLegato);
     gPitchF.setLegatoOnlyGlide(lConstantOrLegato);
 
-    int gAttackPotReading = analogReadFromMux(muxB_S0, muxB_S1, muxB_S2, muxB_Input, KNB_ATTACK_CHAN);
-    int gDecayPotReading = analogReadFromMux(muxB_S0, muxB_S1, muxB_S2, muxB_Input, KNB_DECAY_CHAN);
-    int gSustainPotReading = analogReadFromMux(muxB_S0, muxB_S1, muxB_S2, muxB_Input, KNB_SUSTAIN_CHAN);
-    int gReleasePotReading = analogReadFromMux(muxB_S0, muxB_S1, muxB_S2, muxB_Input, KNB_RELEASE_CHAN);
+    int gAttackPotReading = gParameters.mValue[PARAM_ATTACK];
+    int gDecayPotReading = gParameters.mValue[PARAM_DECAY];
+    int gSustainPotReading = gParameters.mValue[PARAM_SUSTAIN];
+    int gReleasePotReading = gParameters.mValue[PARAM_RELEASE];
     if(gEnvelopeA.mAdsrStatus != OFF_STATE)
     {
+        if(gEnvelopeA.mNewAttack)
+        {
+            gLfoA.syncVoice(0);
+            gEnvelopeA.mNewAttack = false;
+        }
         // lastADSRUpdateTime = currentMillisTime;
         // Serial.println(millis(), DEC);
 
@@ -1041,6 +1468,11 @@ void loop()
     }
     if(gEnvelopeB.mAdsrStatus != OFF_STATE)
     {
+        if(gEnvelopeB.mNewAttack)
+        {
+            gLfoA.syncVoice(1);
+            gEnvelopeB.mNewAttack = false;
+        }
         gEnvelopeB.setAttackKnob(gAttackPotReading);
         gEnvelopeB.setDecayKnob(gDecayPotReading);
         gEnvelopeB.setSustainKnob(gSustainPotReading);
@@ -1051,6 +1483,11 @@ void loop()
     }
     if(gEnvelopeC.mAdsrStatus != OFF_STATE)
     {
+        if(gEnvelopeC.mNewAttack)
+        {
+            gLfoA.syncVoice(2);
+            gEnvelopeC.mNewAttack = false;
+        }
         gEnvelopeC.setAttackKnob(gAttackPotReading);
         gEnvelopeC.setDecayKnob(gDecayPotReading);
         gEnvelopeC.setSustainKnob(gSustainPotReading);
@@ -1061,6 +1498,11 @@ void loop()
     }
     if(gEnvelopeD.mAdsrStatus != OFF_STATE)
     {
+        if(gEnvelopeD.mNewAttack)
+        {
+            gLfoA.syncVoice(3);
+            gEnvelopeD.mNewAttack = false;
+        }
         gEnvelopeD.setAttackKnob(gAttackPotReading);
         gEnvelopeD.setDecayKnob(gDecayPotReading);
         gEnvelopeD.setSustainKnob(gSustainPotReading);
@@ -1071,6 +1513,11 @@ void loop()
     }
     if(gEnvelopeE.mAdsrStatus != OFF_STATE)
     {
+        if(gEnvelopeE.mNewAttack)
+        {
+            gLfoA.syncVoice(4);
+            gEnvelopeE.mNewAttack = false;
+        }
         gEnvelopeE.setAttackKnob(gAttackPotReading);
         gEnvelopeE.setDecayKnob(gDecayPotReading);
         gEnvelopeE.setSustainKnob(gSustainPotReading);
@@ -1081,6 +1528,11 @@ void loop()
     }
     if(gEnvelopeF.mAdsrStatus != OFF_STATE)
     {
+        if(gEnvelopeF.mNewAttack)
+        {
+            gLfoA.syncVoice(5);
+            gEnvelopeF.mNewAttack = false;
+        }
         gEnvelopeF.setAttackKnob(gAttackPotReading);
         gEnvelopeF.setDecayKnob(gDecayPotReading);
         gEnvelopeF.setSustainKnob(gSustainPotReading);
@@ -1089,6 +1541,17 @@ void loop()
         gVcoFtlcValue = gPitchF.calculateOutPitch(gVcoFMidiValue, gEnvelopeF.mAdsrStatus);
         gTlcNeedsUpdate = true;
     }
+
+    // the envelopes are a source too, for the VCA and LPF below and for pitch next loop
+    uint16_t maxVcaValues = 0;
+    for(uint8_t lVoice = 0; lVoice < NUM_VOICES; lVoice++)
+    {
+        gModMatrix.setSource(MOD_SRC_ENVELOPE, lVoice, *gVcaTlcValues[lVoice] >> 5);
+        maxVcaValues = max(maxVcaValues, *gVcaTlcValues[lVoice]);
+    }
+    gModMatrix.setSource(MOD_SRC_ENVELOPE, MOD_GLOBAL, maxVcaValues >> 5);
+    gModMatrix.update();
+
     digitalWrite(debugLedPin, LOW);
     if(gTlcNeedsUpdate)
     {
@@ -1100,24 +1563,31 @@ void loop()
         Tlc.set(vcoETlcPin, gVcoEtlcValue);
         Tlc.set(vcoFTlcPin, gVcoFtlcValue);
 
-        // set VCAs
-        Tlc.set(vcaATlcPin, gVcaAtlcValue);
-        Tlc.set(vcaBTlcPin, gVcaBtlcValue);
-        Tlc.set(vcaCTlcPin, gVcaCtlcValue);
-        Tlc.set(vcaDTlcPin, gVcaDtlcValue);
-        Tlc.set(vcaETlcPin, gVcaEtlcValue);
-        Tlc.set(vcaFTlcPin, gVcaFtlcValue);
+        // set VCAs, after whatever the mod matrix sends them
+        Tlc.set(vcaATlcPin, gModMatrix.applyLevel(MOD_DST_VCA, 0, gVcaAtlcValue));
+        Tlc.set(vcaBTlcPin, gModMatrix.applyLevel(MOD_DST_VCA, 1, gVcaBtlcValue));
+        Tlc.set(vcaCTlcPin, gModMatrix.applyLevel(MOD_DST_VCA, 2, gVcaCtlcValue));
+        Tlc.set(vcaDTlcPin, gModMatrix.applyLevel(MOD_DST_VCA, 3, gVcaDtlcValue));
+        Tlc.set(vcaETlcPin, gModMatrix.applyLevel(MOD_DST_VCA, 4, gVcaEtlcValue));
+        Tlc.set(vcaFTlcPin, gModMatrix.applyLevel(MOD_DST_VCA, 5, gVcaFtlcValue));
 
-        uint16_t maxVcaValues = max(gVcaAtlcValue, max(gVcaBtlcValue,max(gVcaCtlcValue,max(gVcaDtlcValue,max(gVcaEtlcValue,gVcaFtlcValue)))));
         // set white noise VCA
         Tlc.set(noiseTlcPin, maxVcaValues);
         
-        // set VCF
-        uint16_t vcfValueToSet = (maxVcaValues - maxVcaValues * (gLfoA.mLfoVcfScalarOutput + gLfoA.mLfoVcfScalar) / 2);
+        // set VCF. it follows the loudest envelope, then the mod matrix moves it from there
+        uint16_t vcfValueToSet = gMpe.timbreLevel(gModMatrix.applyLevel(MOD_DST_LPF, MOD_GLOBAL, maxVcaValues));
         Tlc.set(lpfTlcPin, vcfValueToSet);
 
         Tlc.update();
         digitalWrite(debugLedPin, HIGH);
         gTlcNeedsUpdate = false;
     }
+
+#if TRACE_ENABLED
+    // the dump blocks on the UART, so only send it when nothing is sounding or when it was asked for
+    if(gTraceCount && (gTraceFlushRequested || (allVoicesOff() && gMidiBuffer.isEmpty())))
+    {
+        traceFlush();
+    }
+#endif
 }
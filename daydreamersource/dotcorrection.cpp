@@ -0,0 +1,126 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "dotcorrection.h"
+#include "eepromlayout.h"
+#include <EEPROM.h>
+#include <Tlc5940.h>
+
+DotCorrection::DotCorrection()
+{
+    for(uint8_t lChannel = 0; lChannel < DOT_CORRECTION_CHANNELS; lChannel++)
+    {
+        mTrim[lChannel] = DOT_CORRECTION_MAX;
+    }
+    mSysexArgs[0] = 0;
+    mSysexArgs[1] = 0;
+}
+
+DotCorrection::~DotCorrection(){}
+
+// returns false and leaves every channel at full level if nothing has been saved yet
+bool DotCorrection::loadFromEeprom()
+{
+    if(EEPROM.read(EEPROM_DOT_CORRECTION_START) != EEPROM_DOT_CORRECTION_MAGIC)
+    {
+        return false;
+    }
+    uint8_t lChecksum = 0;
+    for(uint8_t lChannel = 0; lChannel < DOT_CORRECTION_CHANNELS; lChannel++)
+    {
+        lChecksum += EEPROM.read(EEPROM_DOT_CORRECTION_START + 1 + lChannel);
+    }
+    if(lChecksum != EEPROM.read(EEPROM_DOT_CORRECTION_START + 1 + DOT_CORRECTION_CHANNELS))
+    {
+        return false;
+    }
+    for(uint8_t lChannel = 0; lChannel < DOT_CORRECTION_CHANNELS; lChannel++)
+    {
+        setTrim(lChannel, EEPROM.read(EEPROM_DOT_CORRECTION_START + 1 + lChannel));
+    }
+    return true;
+}
+
+static uint8_t dotCorrectionByte(void *lOwner, uint8_t, uint8_t lChannel)
+{
+    return static_cast<DotCorrection *>(lOwner)->mTrim[lChannel];
+}
+
+// gEepromWriter writes it over the next loops, so a trim sent during a note doesn't stall the UART
+void DotCorrection::save()
+{
+    gEepromWriter.queue(EEPROM_DOT_CORRECTION_START, DOT_CORRECTION_CHANNELS, EEPROM_DOT_CORRECTION_MAGIC, dotCorrectionByte, this, 0);
+}
+
+void DotCorrection::setTrim(uint8_t lChannel, uint8_t lTrim)
+{
+    if(lChannel < DOT_CORRECTION_CHANNELS)
+    {
+        mTrim[lChannel] = lTrim > DOT_CORRECTION_MAX ? DOT_CORRECTION_MAX : lTrim;
+    }
+}
+
+// once at boot and after a change, never per tick
+void DotCorrection::apply()
+{
+#if VPRG_ENABLED
+    // 6 bits a channel, highest channel first like the grayscale data. 16 channels are 12 whole bytes
+    tlc_dcModeStart();
+    uint8_t lByte = 0;
+    uint8_t lBits = 0;
+    for(int8_t lChannel = DOT_CORRECTION_CHANNELS - 1; lChannel >= 0; lChannel--)
+    {
+        for(int8_t lBit = 5; lBit >= 0; lBit--)
+        {
+            lByte = (lByte << 1) | ((mTrim[lChannel] >> lBit) & 1);
+            if(++lBits == 8)
+            {
+                tlc_shift8(lByte);
+                lByte = 0;
+                lBits = 0;
+            }
+        }
+    }
+    pulse_pin(XLAT_PORT, XLAT_PIN);
+    tlc_dcModeStop();
+#endif
+}
+
+// the same trim as a multiplier for the envelope's full level, for boards that can't write the TLC's register
+unsigned int DotCorrection::envelopeScalar(uint8_t lChannel)
+{
+    unsigned int lTrim = lChannel < DOT_CORRECTION_CHANNELS ? mTrim[lChannel] : DOT_CORRECTION_MAX;
+    return (DOT_CORRECTION_TLC_SCALAR * (lTrim + 1) + (DOT_CORRECTION_MAX + 1) / 2) / (DOT_CORRECTION_MAX + 1);
+}
+
+void DotCorrection::sysexByte(uint8_t lIndex, uint8_t lByte)
+{
+    if(lIndex < sizeof(mSysexArgs))
+    {
+        mSysexArgs[lIndex] = lByte;
+    }
+}
+
+// true when a trim changed and needs apply()ing
+bool DotCorrection::endSetTrim(uint8_t lPayloadLength, bool lIsComplete)
+{
+    if(!lIsComplete || lPayloadLength != 2 || mSysexArgs[0] >= DOT_CORRECTION_CHANNELS)
+    {
+        return false;
+    }
+    setTrim(mSysexArgs[0], mSysexArgs[1]);
+    save();
+    return true;
+}
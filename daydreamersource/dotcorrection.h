@@ -0,0 +1,61 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/* DotCorrection Class
+ *
+ * A level trim per TLC5940 channel, so the six analog VCAs can be matched without any maths per tick.
+ * The TLC has a 6 bit dot correction register per output: the channel's current is scaled by (trim + 1) / 64,
+ * so 63 is the full level and every step is about 1.6 %.
+ *
+ * The trims live in EEPROM (see eepromlayout.h) and apply() shifts all of them into the TLC from setup().
+ * That needs the library's VPRG_ENABLED (tlc_config.h) and the TLC's VPRG and DCPRG pins wired to it.
+ * The library puts VPRG on digital 8, which this board uses for mux A, so without that rework
+ * envelopeScalar() gives the VCA channels the same trim through EnvelopeGenerator::mTlcScalar instead.
+ * That multiply happens anyway, but it only has 1/32 steps.
+ *
+ * Set over SysEx (see midiutils.h):
+ *   F0 7D 08 <channel 0 - 0F> <trim 0 - 3F> F7
+ *   the trim is used straight away. gEepromWriter saves all of them over the next few loops.
+*/
+
+#include <stdint.h>
+
+#ifndef DOTCORRECTION_H
+#define DOTCORRECTION_H
+
+#define DOT_CORRECTION_CHANNELS 16
+#define DOT_CORRECTION_MAX 63
+#define DOT_CORRECTION_TLC_SCALAR 32    //EnvelopeGenerator::mTlcScalar at full level
+
+class DotCorrection
+{
+    public:
+    DotCorrection();
+    ~DotCorrection();
+
+    uint8_t mTrim[DOT_CORRECTION_CHANNELS];
+    uint8_t mSysexArgs[2];
+
+    bool loadFromEeprom();
+    void save();
+    void setTrim(uint8_t lChannel, uint8_t lTrim);
+    void apply();
+    unsigned int envelopeScalar(uint8_t lChannel);
+
+    void sysexByte(uint8_t lIndex, uint8_t lByte);
+    bool endSetTrim(uint8_t lPayloadLength, bool lIsComplete);
+};
+
+#endif // DOTCORRECTION_H
@@ -0,0 +1,145 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "eepromlayout.h"
+#include <avr/eeprom.h>
+
+EepromWriter gEepromWriter;
+
+EepromWriter::EepromWriter()
+{
+    mHead = 0;
+    mCount = 0;
+    mStep = 0;
+    mChecksum = 0;
+}
+
+EepromWriter::~EepromWriter(){}
+
+// returns false if the queue is full. queueing a block that is already waiting doesn't add it again,
+// and one that is part way through starts over, so it always ends up with the newest data
+bool EepromWriter::queue(int lAddress, uint8_t lLength, uint8_t lMagic, EepromByteSource lSource, void *lOwner, uint8_t lTag)
+{
+    for(uint8_t i = 0; i < mCount; i++)
+    {
+        if(mQueue[(mHead + i) % EEPROM_WRITE_QUEUE_LENGTH].address == lAddress)
+        {
+            if(i == 0)
+            {
+                mStep = 0;
+                mChecksum = 0;
+            }
+            return true;
+        }
+    }
+    if(mCount == EEPROM_WRITE_QUEUE_LENGTH)
+    {
+        return false;
+    }
+    EepromBlock &lBlock = mQueue[(mHead + mCount) % EEPROM_WRITE_QUEUE_LENGTH];
+    lBlock.address = lAddress;
+    lBlock.length = lLength;
+    lBlock.magic = lMagic;
+    lBlock.source = lSource;
+    lBlock.owner = lOwner;
+    lBlock.tag = lTag;
+    mCount++;
+    return true;
+}
+
+bool EepromWriter::isBusy()
+{
+    return mCount != 0;
+}
+
+bool EepromWriter::isQueued(int lAddress)
+{
+    for(uint8_t i = 0; i < mCount; i++)
+    {
+        if(mQueue[(mHead + i) % EEPROM_WRITE_QUEUE_LENGTH].address == lAddress)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// a block that is already there as it would be written is skipped, so saving it again costs no wear
+bool EepromWriter::blockMatches(const EepromBlock &lBlock)
+{
+    uint8_t lChecksum = 0;
+    for(uint8_t lIndex = 0; lIndex < lBlock.length; lIndex++)
+    {
+        uint8_t lValue = lBlock.source(lBlock.owner, lBlock.tag, lIndex);
+        if(EEPROM.read(lBlock.address + 1 + lIndex) != lValue)
+        {
+            return false;
+        }
+        lChecksum += lValue;
+    }
+    return EEPROM.read(lBlock.address + 1 + lBlock.length) == lChecksum && EEPROM.read(lBlock.address) == lBlock.magic;
+}
+
+// once per loop(). writes at most one cell, and only when the last write has finished, so it never waits.
+// cells that already hold the right value cost a read. returns true while there is more to do
+bool EepromWriter::update()
+{
+    if(!mCount || !eeprom_is_ready())
+    {
+        return isBusy();
+    }
+    EepromBlock &lBlock = mQueue[mHead];
+    if(mStep == 0 && blockMatches(lBlock))
+    {
+        mStep = lBlock.length + 3;
+    }
+    while(mStep < lBlock.length + 3)
+    {
+        int lCell;
+        uint8_t lValue;
+        if(mStep == 0)
+        {
+            lCell = lBlock.address;
+            lValue = 0xFF;
+        }
+        else if(mStep <= lBlock.length)
+        {
+            lCell = lBlock.address + mStep;
+            lValue = lBlock.source(lBlock.owner, lBlock.tag, mStep - 1);
+            mChecksum += lValue;
+        }
+        else if(mStep == lBlock.length + 1)
+        {
+            lCell = lBlock.address + mStep;
+            lValue = mChecksum;
+        }
+        else
+        {
+            lCell = lBlock.address;
+            lValue = lBlock.magic;
+        }
+        mStep++;
+        if(EEPROM.read(lCell) != lValue)
+        {
+            EEPROM.write(lCell, lValue);
+            return true;
+        }
+    }
+    mHead = (mHead + 1) % EEPROM_WRITE_QUEUE_LENGTH;
+    mCount--;
+    mStep = 0;
+    mChecksum = 0;
+    return isBusy();
+}
@@ -0,0 +1,95 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/*
+	where everything lives in the ATMEGA328P's 1024 bytes of EEPROM.
+	each block starts with its own magic byte so a blank (0xFF) or old layout is never decoded.
+
+	every block is laid out the same way: magic, data bytes, then a checksum that is the sum of the data bytes.
+	saves go through gEepromWriter. a cell takes 3.3 ms to write, so writing a block from doMidiStates() would
+	stall loop() long enough to overrun the UART. the owner queues the block instead and EepromWriter::update()
+	writes one cell per loop() once the last one has finished. the data bytes are asked for as they are written,
+	and the checksum is the sum of what was written, so a block is always consistent with itself.
+	the magic is cleared first and written last, so losing power part way leaves the block invalid, not wrong.
+*/
+
+#ifndef EEPROMLAYOUT_H
+#define EEPROMLAYOUT_H
+
+#include <EEPROM.h>
+#include "typedefs.h"
+#include "pitchgenerator.h"
+#include "dotcorrection.h"
+
+#define EEPROM_SIZE 1024
+#define EEPROM_WRITE_QUEUE_LENGTH 8     //blocks waiting to be written. six calibration voices, a preset and the trims
+
+// per voice pitch calibration, see pitchcalibration.h
+// per voice: magic, one delta per gTlcValues entry and a checksum
+#define EEPROM_PITCH_CAL_START  0
+#define EEPROM_PITCH_CAL_MAGIC  0xC2
+#define EEPROM_PITCH_CAL_VOICE_SIZE (1 + tlcTableLength + 1)
+#define EEPROM_PITCH_CAL_SIZE   (NUM_VOICES * EEPROM_PITCH_CAL_VOICE_SIZE)
+
+// parameter presets, see parametersources.h
+// per slot: magic, then every parameter as two bytes (low, high), then a checksum
+#define EEPROM_PRESET_START     (EEPROM_PITCH_CAL_START + EEPROM_PITCH_CAL_SIZE)
+#define EEPROM_PRESET_MAGIC     0xA5
+#define EEPROM_PRESET_SLOTS     8
+#define EEPROM_PRESET_SLOT_SIZE (1 + 2 * NUM_PARAMS + 1)
+#define EEPROM_PRESET_SIZE      (EEPROM_PRESET_SLOTS * EEPROM_PRESET_SLOT_SIZE)
+
+// TLC dot correction, see dotcorrection.h
+// magic, one trim per TLC channel, then a checksum
+#define EEPROM_DOT_CORRECTION_START (EEPROM_PRESET_START + EEPROM_PRESET_SIZE)
+#define EEPROM_DOT_CORRECTION_MAGIC 0xDC
+#define EEPROM_DOT_CORRECTION_SIZE  (1 + DOT_CORRECTION_CHANNELS + 1)
+// used so far: 336 bytes of pitch calibration + 144 of presets + 18 of dot correction = 498
+
+// data byte lIndex of the block, from the owner
+typedef uint8_t (*EepromByteSource)(void *lOwner, uint8_t lTag, uint8_t lIndex);
+
+typedef struct EepromBlock
+{
+    int address;                //of the magic
+    uint8_t length;             //data bytes
+    uint8_t magic;
+    EepromByteSource source;
+    void *owner;
+    uint8_t tag;                //voice, slot, whatever the owner needs to find the data
+} EepromBlock;
+
+class EepromWriter
+{
+    public:
+    EepromWriter();
+    ~EepromWriter();
+
+    EepromBlock mQueue[EEPROM_WRITE_QUEUE_LENGTH];
+    uint8_t mHead;
+    uint8_t mCount;
+    uint8_t mStep;              //0 clears the magic, then the data, the checksum and the magic again
+    uint8_t mChecksum;
+
+    bool queue(int lAddress, uint8_t lLength, uint8_t lMagic, EepromByteSource lSource, void *lOwner, uint8_t lTag);
+    bool update();
+    bool isBusy();
+    bool isQueued(int lAddress);
+    bool blockMatches(const EepromBlock &lBlock);
+};
+
+extern EepromWriter gEepromWriter;
+
+#endif // EEPROMLAYOUT_H
@@ -14,6 +14,7 @@
 */
 
 #include "envelopegenerator.h"
+#include "trace.h"
 #include <HardwareSerial.h>
 
 
@@ -32,6 +33,8 @@ EnvelopeGenerator::EnvelopeGenerator()
     mTlcScalar = 32;
     mTimeScalar = 100;
     mFirstReleaseIteration = false;
+    mVoice = 0;
+    mNewAttack = false;
     mTime = 0;
     mEnvelopeOutput = 0;
     mAdsrStatus = OFF_STATE;
@@ -47,9 +50,21 @@ void EnvelopeGenerator::setVelocity(int lMessageByte)
 {
     mVelocity = lMessageByte;
 }
+void EnvelopeGenerator::setVoice(uint8_t lVoice)
+{
+    mVoice = lVoice;
+}
 void EnvelopeGenerator::setAdsrState(ADSR_STATUSES lNewStatus)
 {
+    if(lNewStatus != mAdsrStatus)
+    {
+        TRACE(TRACE_ENV_STATE, mVoice, lNewStatus);
+    }
     mAdsrStatus = lNewStatus;
+    if(lNewStatus == ATTACK_STATE)
+    {
+        mNewAttack = true;
+    }
 }
 void EnvelopeGenerator::setAttackKnob(int lReading)
 {
@@ -75,8 +90,6 @@ unsigned int EnvelopeGenerator::updateOutput()
     switch(mAdsrStatus)
     {
         case ATTACK_STATE:
-            // Serial.println(millis(), DEC);
-            // Serial.println("attack state");
             mFirstReleaseIteration = true;
             // consider using knobValue to affect mSlope directly, and not use it for time to calculate mSlope from.
             (mTime == 0) ? mEnvelopeOutput = 300 : mEnvelopeOutput; //300 is practically 0. start at 300 to save start time from silence
@@ -94,6 +107,7 @@ unsigned int EnvelopeGenerator::updateOutput()
                 mEnvelopeOutput = mAttackLinearParameters.mFinalAmplitude;
                 mTime = 0;
                 mAdsrStatus = DECAY_STATE;
+                TRACE(TRACE_ENV_STATE, mVoice, DECAY_STATE);
             }
 
             // Serial.print("t = ");   Serial.print(t, DEC);
@@ -107,7 +121,6 @@ unsigned int EnvelopeGenerator::updateOutput()
             break;
 
         case DECAY_STATE:
-            // Serial.println("decay state");
             mDecayLinearParameters.mTimeLength = mDecayKnobValue * mTimeScalar + 1;
             mDecayLinearParameters.mFinalAmplitude = mAttackLinearParameters.mFinalAmplitude * (double)mSustainKnobValue/1023;  //1023 is max 10 bit ADC value  
 
@@ -122,16 +135,15 @@ unsigned int EnvelopeGenerator::updateOutput()
                 mEnvelopeOutput = mDecayLinearParameters.mFinalAmplitude;
                 mTime = 0;
                 mAdsrStatus = SUSTAIN_STATE;
+                TRACE(TRACE_ENV_STATE, mVoice, SUSTAIN_STATE);
             }
             break;
 
         case SUSTAIN_STATE:
-            // Serial.println("sustain state");
             // this does nothing
             break;
 
         case RELEASE_STATE:
-            // Serial.println("release state");
             // reset t when first in release
             if(mFirstReleaseIteration)
             {
@@ -152,6 +164,7 @@ unsigned int EnvelopeGenerator::updateOutput()
                 mEnvelopeOutput = mReleaseLinearParameters.mFinalAmplitude;
                 mTime = 0;
                 mAdsrStatus = OFF_STATE;
+                TRACE(TRACE_ENV_STATE, mVoice, OFF_STATE);
             }
             break;
         case OFF_STATE:
@@ -21,6 +21,7 @@
  *  this will give you the next value that the envelope generator DAC should generate
  */
 
+#include <stdint.h>
 #include "typedefs.h"
 
 class EnvelopeGenerator
@@ -43,6 +44,8 @@ class EnvelopeGenerator
     unsigned int mTlcScalar;        // 127 * 32 = 4064
     unsigned long mTimeScalar;    // increase this value to get longer A,D,R range
     bool mFirstReleaseIteration;
+    uint8_t mVoice;                 // only used to tag trace records
+    bool mNewAttack;                // set on every setAdsrState(ATTACK_STATE), cleared by whoever needs to know about note ons
     unsigned long mTime;
     double mEnvelopeOutput;
     ADSR_STATUSES mAdsrStatus;
@@ -57,6 +60,7 @@ class EnvelopeGenerator
     //functions
     unsigned int updateOutput();
 
+    void setVoice(uint8_t lVoice);
     void setAdsrState(ADSR_STATUSES lNewStatus);
     void setAttackKnob(int lReading);
     void setDecayKnob(int lReading);
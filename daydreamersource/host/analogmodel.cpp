@@ -0,0 +1,135 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it
+*   under the terms of the GNU General Public License as published by the Free Software Foundation,
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "analogmodel.h"
+#include "../pitchgenerator.h"
+#include "../../noise/noiselfsr.h"
+#include <math.h>
+
+// soft clip for the ladder input, close to tanh up to +-3
+static inline float saturate(float x)
+{
+    x = x > 3.0f ? 3.0f : (x < -3.0f ? -3.0f : x);
+    return x * (27.0f + x * x) / (27.0f + 9.0f * x * x);
+}
+
+AnalogModel::AnalogModel()
+{
+    // run gTlcValues backwards: find the two entries either side of the CV and interpolate the note between them.
+    // above the last entry keep the slope of the last step
+    unsigned int lLast = tlcTableLength - 1;
+    unsigned int i = 0;
+    for(unsigned int lCv = 0; lCv < MODEL_CV_STEPS; lCv++)
+    {
+        while(i + 1 < lLast && pgm_read_word_near(gTlcValues + i + 1) <= lCv)
+        {
+            i++;
+        }
+        float lLow = pgm_read_word_near(gTlcValues + i);
+        float lHigh = pgm_read_word_near(gTlcValues + i + 1);
+        float lNote = (lowestMidi - noteLimitOffset) + i + (lCv - lLow) / (lHigh > lLow ? lHigh - lLow : 1.0f);
+        float lHz = 440.0f * powf(2.0f, (lNote - 69.0f) / 12.0f);
+        mIncrementTable[lCv] = lHz / MODEL_SAMPLE_RATE;
+
+        float lCutoff = MODEL_LPF_LOWEST * powf(2.0f, MODEL_LPF_OCTAVES * lCv / (MODEL_CV_STEPS - 1));
+        lCutoff = lCutoff > 0.45f * MODEL_SAMPLE_RATE ? 0.45f * MODEL_SAMPLE_RATE : lCutoff;
+        mCutoffTable[lCv] = tanf(M_PI * lCutoff / MODEL_SAMPLE_RATE);
+    }
+
+    for(int lLane = 0; lLane < MODEL_LANES; lLane++)
+    {
+        mPhase[lLane] = 0;
+        mIncrement[lLane] = mIncrementTable[0];
+        mGain[lLane] = 0;
+    }
+    mNoiseReg = NOISE_LFSR_SEED;
+    mNoisePhase = 0;
+    mNoiseValue = 0;
+    mNoiseGain = 0;
+    mCutoff = mCutoffTable[0];
+    for(int s = 0; s < 4; s++)
+    {
+        mStage[s] = 0;
+    }
+}
+
+void AnalogModel::render(const uint16_t lCv[HOST_TLC_USED], float *lOut, unsigned int lSamples)
+{
+    if(lSamples == 0)
+    {
+        return;
+    }
+
+    // per sample steps that take every lane from where it is to the new CV by the end of the block.
+    // the spare lanes keep their starting increment and a gain of 0
+    ModelVector lIncrementStep = mIncrement;
+    ModelVector lGainStep = mGain;
+    for(int lLane = 0; lLane < NUM_VOICES; lLane++)
+    {
+        lIncrementStep[lLane] = mIncrementTable[lCv[HOST_TLC_VCO_FIRST + lLane] % MODEL_CV_STEPS];
+        lGainStep[lLane] = lCv[HOST_TLC_VCA_FIRST + lLane] / (float)(MODEL_CV_STEPS - 1);
+    }
+    lIncrementStep = (lIncrementStep - mIncrement) / (float)lSamples;
+    lGainStep = (lGainStep - mGain) / (float)lSamples;
+    float lNoiseGainStep = ((lCv[HOST_TLC_NOISE] / (float)(MODEL_CV_STEPS - 1)) * MODEL_NOISE_LEVEL - mNoiseGain) / lSamples;
+    float lCutoffStep = (mCutoffTable[lCv[HOST_TLC_LPF] % MODEL_CV_STEPS] - mCutoff) / lSamples;
+
+    const ModelVector lZero = mPhase - mPhase;
+    const ModelVector lOne = lZero + 1.0f;
+
+    for(unsigned int n = 0; n < lSamples; n++)
+    {
+        mIncrement += lIncrementStep;
+        mGain += lGainStep;
+
+        // all six oscillators at once
+        mPhase += mIncrement;
+        mPhase = (mPhase >= lOne) ? mPhase - lOne : mPhase;
+        ModelVector lInverse = lOne / mIncrement;
+        ModelVector lStart = mPhase * lInverse;             //how far past the reset, in samples
+        ModelVector lEnd = (mPhase - lOne) * lInverse;      //how far before the next one
+        ModelVector lBlep = (mPhase < mIncrement) ? lStart + lStart - lStart * lStart - lOne :
+            ((mPhase > lOne - mIncrement) ? lEnd * lEnd + lEnd + lEnd + lOne : lZero);
+        ModelVector lVoices = (mPhase + mPhase - lOne - lBlep) * mGain;
+
+        float lMix = 0;
+        for(int lLane = 0; lLane < MODEL_LANES; lLane++)
+        {
+            lMix += lVoices[lLane];
+        }
+
+        // noise is held between LFSR steps, same as the pin on the ATTINY45
+        mNoisePhase += MODEL_NOISE_RATE / MODEL_SAMPLE_RATE;
+        while(mNoisePhase >= 1.0f)
+        {
+            mNoiseValue = noiseLfsrStep(mNoiseReg) ? 1.0f : -1.0f;
+            mNoisePhase -= 1.0f;
+        }
+        mNoiseGain += lNoiseGainStep;
+        lMix += mNoiseValue * mNoiseGain;
+
+        // four trapezoidal one poles with the last one fed back
+        mCutoff += lCutoffStep;
+        float lG = mCutoff / (1.0f + mCutoff);
+        float lX = saturate(lMix - MODEL_LPF_RESONANCE * mStage[3]);
+        for(int s = 0; s < 4; s++)
+        {
+            float v = (lX - mStage[s]) * lG;
+            lX = v + mStage[s];
+            mStage[s] = lX + v;
+        }
+        lOut[n] = lX * MODEL_OUTPUT_GAIN;
+    }
+}
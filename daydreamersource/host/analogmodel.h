@@ -0,0 +1,73 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it
+*   under the terms of the GNU General Public License as published by the Free Software Foundation,
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/*
+ *  software stand-in for the analog side of the board, driven by the 14 TLC outputs
+ *  - VCO: saw with polyBLEP edges. the TLC value goes back through gTlcValues to a note, so a calibrated
+ *    board and this model play the same pitch for the same CV
+ *  - VCA: linear in the TLC value
+ *  - noise: the same LFSR as the ATTINY45 (noise/noiselfsr.h) at 100 kHz, through its own VCA
+ *  - LPF: one 4 pole ladder after the mix, cutoff exponential in the TLC value
+ *
+ *  the six voices are the lanes of one vector, so every sample does all of them with the same instructions.
+ *  GCC vector extensions turn into SSE by default and AVX with -mavx (8 lanes in one register).
+ *  CV only changes once per loop(), so it is ramped across each block like the RC on the real CV lines would.
+ */
+
+#ifndef ANALOGMODEL_H
+#define ANALOGMODEL_H
+
+#include <stdint.h>
+#include "hostsketch.h"
+
+#define MODEL_SAMPLE_RATE 48000
+#define MODEL_LANES 8                   //NUM_VOICES rounded up to a whole vector. the spare lanes stay silent
+#define MODEL_CV_STEPS 4096
+#define MODEL_NOISE_RATE 100000.0f      //NOISE_RATE_100K
+#define MODEL_NOISE_LEVEL 0.25f         //noise against one full voice
+#define MODEL_LPF_LOWEST 30.0f          //cutoff at TLC 0
+#define MODEL_LPF_OCTAVES 9.3f          //cutoff at TLC 4095 is about 19 kHz
+#define MODEL_LPF_RESONANCE 1.0f        //ladder feedback, 4 is self oscillation
+#define MODEL_OUTPUT_GAIN (1.0f / 3.0f) //six voices at full level with headroom
+
+typedef float ModelVector __attribute__((vector_size(MODEL_LANES * sizeof(float))));
+typedef int32_t ModelMask __attribute__((vector_size(MODEL_LANES * sizeof(int32_t))));
+
+class AnalogModel
+{
+public:
+    AnalogModel();
+
+    // renders lSamples of mono output, ramping from the last CV to lCv over the block
+    void render(const uint16_t lCv[HOST_TLC_USED], float *lOut, unsigned int lSamples);
+
+private:
+    float mIncrementTable[MODEL_CV_STEPS];  //phase increment per sample for each VCO CV
+    float mCutoffTable[MODEL_CV_STEPS];     //ladder g = tan(pi * fc / fs) for each LPF CV
+
+    ModelVector mPhase;
+    ModelVector mIncrement;
+    ModelVector mGain;
+
+    uint32_t mNoiseReg;
+    float mNoisePhase;
+    float mNoiseValue;
+    float mNoiseGain;
+
+    float mCutoff;
+    float mStage[4];
+};
+
+#endif // ANALOGMODEL_H
@@ -0,0 +1,60 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/*
+	host stand-ins for the Arduino core, just enough to build the sketch on a PC.
+	pins, the ADC and the UART are emulated in host/hostsketch.cpp.
+*/
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <avr/interrupt.h>
+#include "HardwareSerial.h"
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+#define NUM_HOST_PINS 20
+
+// the core has these as macros. templates keep the mixed int/unsigned calls in the sketch compiling
+template<class T, class U> inline T max(T a, U b) { return a > static_cast<T>(b) ? a : static_cast<T>(b); }
+template<class T, class U> inline T min(T a, U b) { return a < static_cast<T>(b) ? a : static_cast<T>(b); }
+
+void pinMode(uint8_t lPin, uint8_t lMode);
+void digitalWrite(uint8_t lPin, uint8_t lValue);
+int digitalRead(uint8_t lPin);
+int analogRead(uint8_t lPin);
+unsigned long micros();
+unsigned long millis();
+void delay(unsigned long lMs);
+void delayMicroseconds(unsigned int lUs);
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,38 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#ifndef HOST_EEPROM_H
+#define HOST_EEPROM_H
+
+#include <stdint.h>
+
+#define HOST_EEPROM_SIZE 1024
+
+// starts blank (0xFF) like a new chip
+class EEPROMClass
+{
+    public:
+    EEPROMClass();
+    uint8_t mData[HOST_EEPROM_SIZE];
+    unsigned long mWrites;
+    unsigned long mReadyAt;     //host micros when the last write finishes, see avr/eeprom.h
+
+    uint8_t read(int lAddress);
+    void write(int lAddress, uint8_t lValue);
+};
+
+extern EEPROMClass EEPROM;
+
+#endif // HOST_EEPROM_H
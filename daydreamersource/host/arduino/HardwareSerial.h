@@ -0,0 +1,55 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#ifndef HOST_HARDWARESERIAL_H
+#define HOST_HARDWARESERIAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define DEC 10
+#define HEX 16
+#define SERIAL_RX_BUFFER_SIZE 64    //same as the 1.0.6 core. bytes past this are dropped like a real overrun
+
+class HardwareSerial
+{
+    public:
+    HardwareSerial();
+
+    uint8_t mRx[SERIAL_RX_BUFFER_SIZE];
+    uint8_t mRxHead;
+    uint8_t mRxCount;
+    unsigned long mRxOverruns;
+    unsigned long mTxBytes;
+
+    void begin(unsigned long lBaud);
+    int available();
+    int read();
+    int peek();
+    size_t write(uint8_t lByte);
+    void flush();
+
+    // host side: a byte arriving on the RX pin
+    void receive(uint8_t lByte);
+
+    // debug prints go nowhere
+    template<class T> size_t print(T, int = DEC) { return 0; }
+    template<class T> size_t println(T, int = DEC) { return 0; }
+    size_t println() { return 0; }
+};
+
+extern HardwareSerial Serial;
+
+#endif // HOST_HARDWARESERIAL_H
@@ -0,0 +1,22 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// on the AVR this pulls in maniacbug's STL port. the host has the real one
+#ifndef HOST_STANDARDCPLUSPLUS_H
+#define HOST_STANDARDCPLUSPLUS_H
+
+#include <algorithm>
+
+#endif // HOST_STANDARDCPLUSPLUS_H
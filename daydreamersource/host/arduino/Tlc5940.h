@@ -0,0 +1,44 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#ifndef HOST_TLC5940_H
+#define HOST_TLC5940_H
+
+#include <stdint.h>
+
+#define NUM_TLCS 1
+#define TLC_CHANNELS (NUM_TLCS * 16)
+
+// set() fills the grayscale buffer, update() latches it to mOutput like the XLAT pulse does
+class Tlc5940
+{
+    public:
+    Tlc5940();
+    uint16_t mGrayscale[TLC_CHANNELS];
+    uint16_t mOutput[TLC_CHANNELS];
+    uint8_t mDotCorrection[TLC_CHANNELS];
+    unsigned long mUpdates;
+
+    void init(uint16_t lInitialValue = 0);
+    void clear();
+    void set(uint8_t lChannel, uint16_t lValue);
+    uint16_t get(uint8_t lChannel);
+    void setAll(uint16_t lValue);
+    uint8_t update();
+};
+
+extern Tlc5940 Tlc;
+
+#endif // HOST_TLC5940_H
@@ -0,0 +1,444 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/*
+ *  the sketch and the Arduino stand-ins, see hostsketch.h
+ */
+
+#include "Arduino.h"
+#include "../daydreamersource.ino"
+#include "hostsketch.h"
+#include <avr/eeprom.h>
+
+HostStats gHostStats;
+unsigned long gHostLoopUs = HOST_DEFAULT_LOOP_US;
+void (*gHostLfoTickCallback)() = 0;
+
+static unsigned long gHostMicros = 0;
+static unsigned long gHostNextLfoTick = HOST_LFO_TICK_US;
+static uint8_t gHostPinLevel[NUM_HOST_PINS];
+static int gHostKnobs[8];
+static bool gHostModeSwitches[8];
+static bool gHostMidiSwitches[8];
+static uint8_t gHostMidiChannel = 0;
+
+/********************registers and library objects***********************************/
+
+volatile uint8_t SREG;
+volatile uint8_t TCCR0A;
+volatile uint8_t TCCR0B;
+volatile uint8_t TCNT0;
+volatile uint8_t OCR0A;
+volatile uint8_t TIMSK0;
+volatile uint8_t TIFR0;
+
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+Tlc5940 Tlc;
+
+void sleep_cpu()
+{
+    gHostStats.sleeps++;
+}
+
+HardwareSerial::HardwareSerial()
+{
+    mRxHead = 0;
+    mRxCount = 0;
+    mRxOverruns = 0;
+    mTxBytes = 0;
+}
+
+void HardwareSerial::begin(unsigned long) {}
+
+int HardwareSerial::available()
+{
+    return mRxCount;
+}
+
+int HardwareSerial::peek()
+{
+    return mRxCount ? mRx[mRxHead] : -1;
+}
+
+int HardwareSerial::read()
+{
+    if(!mRxCount)
+    {
+        return -1;
+    }
+    uint8_t lByte = mRx[mRxHead];
+    mRxHead = (mRxHead + 1) % SERIAL_RX_BUFFER_SIZE;
+    mRxCount--;
+
+    // checkMidi() pushes this straight into gMidiBuffer
+    if(gMidiBuffer.isFull())
+    {
+        gHostStats.queueDrops++;
+    }
+    else if(gMidiBuffer.size() + 1 > gHostStats.peakQueueDepth)
+    {
+        gHostStats.peakQueueDepth = gMidiBuffer.size() + 1;
+    }
+    return lByte;
+}
+
+size_t HardwareSerial::write(uint8_t)
+{
+    mTxBytes++;
+    return 1;
+}
+
+void HardwareSerial::flush() {}
+
+void HardwareSerial::receive(uint8_t lByte)
+{
+    if(mRxCount == SERIAL_RX_BUFFER_SIZE)
+    {
+        mRxOverruns++;
+        return;
+    }
+    mRx[(mRxHead + mRxCount) % SERIAL_RX_BUFFER_SIZE] = lByte;
+    mRxCount++;
+}
+
+EEPROMClass::EEPROMClass()
+{
+    memset(mData, 0xFF, sizeof(mData));
+    mWrites = 0;
+    mReadyAt = 0;
+}
+
+// the AVR busy waits on a write that is still going before it reads or writes again, and so does host time.
+// a save that writes cell after cell from loop() shows up as a long loop() and a burst of MIDI bytes
+static void hostEepromWait()
+{
+    if(gHostMicros < EEPROM.mReadyAt)
+    {
+        gHostStats.eepromStallUs += EEPROM.mReadyAt - gHostMicros;
+        gHostMicros = EEPROM.mReadyAt;
+    }
+}
+
+uint8_t EEPROMClass::read(int lAddress)
+{
+    hostEepromWait();
+    return mData[lAddress % HOST_EEPROM_SIZE];
+}
+
+void EEPROMClass::write(int lAddress, uint8_t lValue)
+{
+    hostEepromWait();
+    mData[lAddress % HOST_EEPROM_SIZE] = lValue;
+    mWrites++;
+    mReadyAt = gHostMicros + HOST_EEPROM_WRITE_US;
+}
+
+bool eeprom_is_ready()
+{
+    return gHostMicros >= EEPROM.mReadyAt;
+}
+
+Tlc5940::Tlc5940()
+{
+    clear();
+    memset(mOutput, 0, sizeof(mOutput));
+    memset(mDotCorrection, 63, sizeof(mDotCorrection));
+    mUpdates = 0;
+}
+
+void Tlc5940::init(uint16_t lInitialValue)
+{
+    setAll(lInitialValue);
+    update();
+}
+
+void Tlc5940::clear()
+{
+    setAll(0);
+}
+
+void Tlc5940::set(uint8_t lChannel, uint16_t lValue)
+{
+    mGrayscale[lChannel % TLC_CHANNELS] = lValue & 0x0FFF;
+}
+
+uint16_t Tlc5940::get(uint8_t lChannel)
+{
+    return mGrayscale[lChannel % TLC_CHANNELS];
+}
+
+void Tlc5940::setAll(uint16_t lValue)
+{
+    for(uint8_t lChannel = 0; lChannel < TLC_CHANNELS; lChannel++)
+    {
+        set(lChannel, lValue);
+    }
+}
+
+uint8_t Tlc5940::update()
+{
+    memcpy(mOutput, mGrayscale, sizeof(mOutput));
+    mUpdates++;
+    return 0;
+}
+
+/********************pins: the three muxes***********************************/
+
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t lPin, uint8_t lValue)
+{
+    if(lPin < NUM_HOST_PINS)
+    {
+        gHostPinLevel[lPin] = lValue ? HIGH : LOW;
+    }
+}
+
+static uint8_t muxChannel(uint8_t lS0Pin, uint8_t lS1Pin, uint8_t lS2Pin)
+{
+    return gHostPinLevel[lS0Pin] | (gHostPinLevel[lS1Pin] << 1) | (gHostPinLevel[lS2Pin] << 2);
+}
+
+int digitalRead(uint8_t lPin)
+{
+    if(lPin == muxA_Input)
+    {
+        return gHostModeSwitches[muxChannel(muxA_S0, muxA_S1, muxA_S2)];
+    }
+    if(lPin == muxC_Input)
+    {
+        return gHostMidiSwitches[muxChannel(muxC_S0, muxC_S1, muxC_S2)];
+    }
+    return lPin < NUM_HOST_PINS ? gHostPinLevel[lPin] : LOW;
+}
+
+int analogRead(uint8_t lPin)
+{
+    gHostStats.adcReads++;
+    if(lPin == muxB_Input)
+    {
+        return gHostKnobs[muxChannel(muxB_S0, muxB_S1, muxB_S2)];
+    }
+    return 0;
+}
+
+unsigned long micros()
+{
+    return gHostMicros;
+}
+
+unsigned long millis()
+{
+    return gHostMicros / 1000;
+}
+
+void delay(unsigned long lMs)
+{
+    gHostMicros += lMs * 1000;
+}
+
+void delayMicroseconds(unsigned int lUs)
+{
+    gHostMicros += lUs;
+}
+
+void hostTrace(uint8_t lEvent, uint8_t, uint8_t)
+{
+    switch(lEvent)
+    {
+        case TRACE_NOTE_ON:
+            gHostStats.noteOns++;
+            break;
+        case TRACE_NOTE_OFF:
+            gHostStats.noteOffs++;
+            break;
+        case TRACE_VOICE_ASSIGN:
+            gHostStats.assigns++;
+            break;
+        case TRACE_VOICE_STEAL:
+            gHostStats.steals++;
+            break;
+        case TRACE_VOICE_FREE:
+            gHostStats.frees++;
+            break;
+        case TRACE_ENV_STATE:
+            gHostStats.envelopeChanges++;
+            break;
+        default:
+            break;
+    }
+}
+
+/********************host interface***********************************/
+
+void hostBegin()
+{
+    memset(&gHostStats, 0, sizeof(gHostStats));
+    gHostMidiChannel = 0;
+    // every switch off (pulled up), channel 1, knobs centred with a short envelope
+    for(uint8_t lChannel = 0; lChannel < 8; lChannel++)
+    {
+        gHostModeSwitches[lChannel] = HIGH;
+        gHostMidiSwitches[lChannel] = HIGH;
+        gHostKnobs[lChannel] = 512;
+    }
+    gHostKnobs[KNB_ATTACK_CHAN] = 0;
+    gHostKnobs[KNB_DECAY_CHAN] = 0;
+    gHostKnobs[KNB_SUSTAIN_CHAN] = 1023;
+    gHostKnobs[KNB_RELEASE_CHAN] = 0;
+    gHostKnobs[KNB_GLIDE_CHAN] = 0;
+    setup();
+}
+
+void hostRunLoop()
+{
+    TCNT0 = (gHostMicros % HOST_LFO_TICK_US) / 16;
+    loop();
+    gHostStats.loops++;
+    gHostMicros += gHostLoopUs;
+    while(gHostMicros >= gHostNextLfoTick)
+    {
+        TIMER0_COMPA_vect();
+        gHostStats.lfoTicks++;
+        gHostNextLfoTick += HOST_LFO_TICK_US;
+        if(gHostLfoTickCallback)
+        {
+            gHostLfoTickCallback();
+        }
+    }
+}
+
+unsigned long hostMicros()
+{
+    return gHostMicros;
+}
+
+void hostSetKnob(uint8_t lChannel, int lValue)
+{
+    gHostKnobs[lChannel & 7] = lValue;
+}
+
+int hostKnobChannel(const char *lName)
+{
+    static const struct {const char *name; uint8_t channel;} lKnobs[] = {
+        {"attack", KNB_ATTACK_CHAN}, {"decay", KNB_DECAY_CHAN}, {"sustain", KNB_SUSTAIN_CHAN}, {"release", KNB_RELEASE_CHAN},
+        {"glide", KNB_GLIDE_CHAN}, {"lfofreq", KNB_MOD_FRQ_CHAN}, {"lfovcf", KNB_MOD_VCF_AMT_CHAN}, {"lfovco", KNB_MOD_VCO_AMT_CHAN}
+    };
+    for(uint8_t i = 0; i < sizeof(lKnobs) / sizeof(lKnobs[0]); i++)
+    {
+        if(strcmp(lName, lKnobs[i].name) == 0)
+        {
+            return lKnobs[i].channel;
+        }
+    }
+    return -1;
+}
+
+void hostSetModeSwitch(uint8_t lChannel, bool lLevel)
+{
+    gHostModeSwitches[lChannel & 7] = lLevel;
+}
+
+void hostSetMidiSwitch(uint8_t lChannel, bool lLevel)
+{
+    gHostMidiSwitches[lChannel & 7] = lLevel;
+}
+
+// feeds a message in at wire speed and lets loop() take it
+static void hostSendMidi(const uint8_t *lBytes, uint8_t lLength)
+{
+    for(uint8_t i = 0; i < lLength; i++)
+    {
+        hostReceiveMidi(lBytes[i]);
+        unsigned long lUntil = gHostMicros + HOST_MIDI_BYTE_US;
+        while(gHostMicros < lUntil)
+        {
+            hostRunLoop();
+        }
+    }
+}
+
+// the switch combination loop() turns into each mode. a switch that is on reads LOW.
+// POLY_MPE has no switch position: the panel is left on POLY_1, where the synth goes when the zone is turned off,
+// and the zone is set up the way a controller does it, RPN 6 on the channel from hostSetMidiChannel() with
+// every other channel a member. so set the channel first
+void hostSetPolyphony(POLYPHONY lMode)
+{
+    bool lPoly = (lMode == POLY_1 || lMode == POLY_2 || lMode == POLY_3 || lMode == POLY_MPE);
+    hostSetModeSwitch(SW_MONO_POLY_CHAN, lPoly ? LOW : HIGH);
+    hostSetModeSwitch(SW_1OSC_1OSC_CHAN, (lMode == MONO_1 || lMode == POLY_1 || lMode == POLY_MPE) ? LOW : HIGH);
+    hostSetModeSwitch(SW_1OSC_3OSC_CHAN, (lMode == MONO_3 || lMode == POLY_3) ? LOW : HIGH);
+    hostSetModeSwitch(SW_1OSC_2OSC_CHAN, (lMode == MONO_2 || lMode == POLY_2) ? LOW : HIGH);
+    if(lMode == POLY_MPE)
+    {
+        uint8_t lStatus = STATUS_CONTROL | gHostMidiChannel;
+        const uint8_t lZone[] = {lStatus, CONTROL_RPN_MSB, 0, lStatus, CONTROL_RPN_LSB, RPN_MPE_CONFIGURATION,
+            lStatus, CONTROL_DATA, MPE_CHANNELS - 1};
+        hostSendMidi(lZone, sizeof(lZone));
+        hostRunLoop();
+    }
+}
+
+void hostSetMidiChannel(uint8_t lChannel)
+{
+    gHostMidiChannel = lChannel & 0x0F;
+    hostSetMidiSwitch(SW_MIDICHAN_BIT3_CHAN, (lChannel & 1) ? LOW : HIGH);
+    hostSetMidiSwitch(SW_MIDICHAN_BIT2_CHAN, (lChannel & 2) ? LOW : HIGH);
+    hostSetMidiSwitch(SW_MIDICHAN_BIT1_CHAN, (lChannel & 4) ? LOW : HIGH);
+    hostSetMidiSwitch(SW_MIDICHAN_BIT0_CHAN, (lChannel & 8) ? LOW : HIGH);
+}
+
+void hostReceiveMidi(uint8_t lByte)
+{
+    Serial.receive(lByte);
+    gHostStats.midiBytes++;
+}
+
+void hostParseMidi(uint8_t lByte)
+{
+    parseMidiByte(lByte);
+    // nothing runs doMidiStates(), so take the message off the parser here
+    if(gMidiState.parseStatus == DONE)
+    {
+        gMidiState.parseStatus = STATUS;
+    }
+}
+
+unsigned long hostRxOverruns()
+{
+    return Serial.mRxOverruns;
+}
+
+uint16_t hostTlcOutput(uint8_t lChannel)
+{
+    return Tlc.mOutput[lChannel % TLC_CHANNELS];
+}
+
+ADSR_STATUSES hostVoiceState(uint8_t lVoice)
+{
+    EnvelopeGenerator *lEnvelopes[NUM_VOICES] = {&gEnvelopeA, &gEnvelopeB, &gEnvelopeC, &gEnvelopeD, &gEnvelopeE, &gEnvelopeF};
+    return lEnvelopes[lVoice % NUM_VOICES]->mAdsrStatus;
+}
+
+unsigned int hostNotesPressed()
+{
+    return gNotesPressed.size();
+}
+
+IdleReport hostIdleReport()
+{
+    return gIdle.mReport;
+}
@@ -0,0 +1,91 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/*
+ *  host build of the sketch
+ *  hostsketch.cpp compiles the real daydreamersource.ino against the stand-ins in host/arduino,
+ *  emulates the three muxes, the MIDI UART and TIMER0, and gives the host tools this interface to drive it.
+ *
+ *  the sketch is all globals and function statics, so there is exactly one synth per process.
+ *  tools that want a clean synth per run fork a new process for it.
+ *
+ *  time is simulated: every hostRunLoop() is one loop() that takes gHostLoopUs,
+ *  and the TIMER0 interrupt fires every HOST_LFO_TICK_US of that.
+ */
+
+#ifndef HOSTSKETCH_H
+#define HOSTSKETCH_H
+
+#include <stdint.h>
+#include "../typedefs.h"
+#include "../idlemonitor.h"
+
+#define HOST_LFO_TICK_US 4096       //TIMER0: 16 MHz / 256 prescaler / 256 counts
+#define HOST_MIDI_BYTE_US 320       //10 bits at 31250 baud
+#define HOST_DEFAULT_LOOP_US 1000
+
+// TLC channels, same as the sketch
+#define HOST_TLC_VCO_FIRST 0
+#define HOST_TLC_VCA_FIRST 6
+#define HOST_TLC_NOISE 12
+#define HOST_TLC_LPF 13
+#define HOST_TLC_USED 14
+
+typedef struct HostStats
+{
+    unsigned long loops;
+    unsigned long lfoTicks;
+    unsigned long midiBytes;
+    unsigned long noteOns;
+    unsigned long noteOffs;
+    unsigned long assigns;
+    unsigned long steals;
+    unsigned long frees;
+    unsigned long envelopeChanges;
+    int peakQueueDepth;         //gMidiBuffer, counted as each byte is moved into it
+    unsigned long queueDrops;   //bytes lost because gMidiBuffer was full
+    unsigned long adcReads;
+    unsigned long sleeps;       //times loop() slept while quiescent
+    unsigned long eepromStallUs;    //host time loop() spent waiting on an EEPROM write
+} HostStats;
+
+extern HostStats gHostStats;
+extern unsigned long gHostLoopUs;
+extern void (*gHostLfoTickCallback)();  //runs after every TIMER0 interrupt, for sampling the outputs
+
+void hostBegin();
+void hostRunLoop();
+unsigned long hostMicros();
+
+// panel
+void hostSetKnob(uint8_t lChannel, int lValue);         //KNB_ channels on mux B, 0 - 1023
+int hostKnobChannel(const char *lName);                 //attack, decay, sustain, release, glide, lfofreq, lfovcf, lfovco. -1 if unknown
+void hostSetModeSwitch(uint8_t lChannel, bool lLevel);  //SW_ channels on mux A. switches pull low when on
+void hostSetMidiSwitch(uint8_t lChannel, bool lLevel);  //SW_ channels on mux C
+void hostSetPolyphony(POLYPHONY lMode);                 //POLY_MPE also sets up a zone on the MIDI channel, so set that first
+void hostSetMidiChannel(uint8_t lChannel);
+
+// MIDI in
+void hostReceiveMidi(uint8_t lByte);
+void hostParseMidi(uint8_t lByte);                      //straight into parseMidiByte(), no UART, gMidiBuffer or loop(). for timing the parser
+unsigned long hostRxOverruns();
+
+// outputs and state
+uint16_t hostTlcOutput(uint8_t lChannel);
+ADSR_STATUSES hostVoiceState(uint8_t lVoice);
+unsigned int hostNotesPressed();
+IdleReport hostIdleReport();
+
+#endif // HOSTSKETCH_H
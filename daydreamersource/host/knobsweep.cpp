@@ -0,0 +1,363 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/*
+ *  knob to time sweep
+ *  what a knob position means in milliseconds. every knob value 0 - 1023 goes through the real EnvelopeGenerator
+ *  and PitchGenerator, one update per loop() like the sketch does, for every velocity (envelope segments)
+ *  or glide interval (1 - 24 semitones up).
+ *
+ *  for each segment, knob and velocity/interval:
+ *      ticks       updates until the segment hands over to the next one
+ *      ms          ticks * loop time (-l, the sketch's loop() period)
+ *      t90         ms until it is 90 % of the way there
+ *      nominal     the length the code asks for: knob * mTimeScalar + 1 ticks for the envelope, knob ticks for glide
+ *      accuracy    ticks / nominal. under 1 means the segment got where it was going early
+ *      overshoot   how far past the target it went before the segment snapped to it. TLC counts
+ *
+ *  the knobs are spread over -j forked workers, which write straight into a shared table.
+ *  a summary goes to stdout, the full table to -o as CSV for fitting curve tables to.
+ *
+ *  build:  g++ -O2 -std=gnu++11 -DHOST_BUILD -Idaydreamersource/host/arduino -Idaydreamersource -o knobsweep \
+ *              daydreamersource/host/knobsweep.cpp daydreamersource/host/hostsketch.cpp daydreamersource/[a-z]*.cpp
+ *  run:    ./knobsweep [-j jobs] [-l loop us] [-s sustain knob] [-k knob step] [-v velocity step] [-o sweep.csv]
+ *          -s      sustain level the decay heads for, default 0 so decay covers the whole range
+ *          -k, -v  only every nth knob value / velocity, for a quick look
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "hostsketch.h"
+#include "../envelopegenerator.h"
+#include "../pitchgenerator.h"
+
+#define SWEEP_KNOBS 1024
+#define SWEEP_VELOCITIES 127        //1 - 127
+#define SWEEP_INTERVALS 24          //glide, semitones up from SWEEP_GLIDE_FROM
+#define SWEEP_GLIDE_FROM 48
+#define SWEEP_AXIS SWEEP_VELOCITIES
+#define SWEEP_SUMMARY_STEP 64       //summary rows every this many knob values
+#define SWEEP_SUMMARY_VELOCITY 127
+#define SWEEP_SUMMARY_INTERVAL 12
+
+typedef enum {SEG_ATTACK, SEG_DECAY, SEG_RELEASE, SEG_GLIDE, NUM_SEGMENTS} SEGMENTS;
+
+const char *gSegmentNames[NUM_SEGMENTS] = {"attack", "decay", "release", "glide"};
+
+typedef struct SweepPoint
+{
+    uint32_t ticks;
+    uint32_t t90Ticks;
+    uint32_t nominalTicks;
+    float overshoot;
+    uint8_t done;
+} SweepPoint;
+
+// [segment][knob][velocity - 1 or interval - 1], shared with the workers
+static SweepPoint *gTable;
+
+static SweepPoint &point(int lSegment, int lKnob, int lAxis)
+{
+    return gTable[(lSegment * SWEEP_KNOBS + lKnob) * SWEEP_AXIS + lAxis];
+}
+
+static int axisLength(int lSegment)
+{
+    return lSegment == SEG_GLIDE ? SWEEP_INTERVALS : SWEEP_VELOCITIES;
+}
+
+/********************the measurements***********************************/
+
+// steps the envelope until it leaves lSegment. lTarget is where the segment is heading, lFrom where it started
+static void runEnvelope(EnvelopeGenerator &lEnvelope, ADSR_STATUSES lSegment, double lFrom, double lTarget, SweepPoint &lPoint)
+{
+    uint32_t lLimit = lPoint.nominalTicks * 4 + 1000;
+    bool lRising = lTarget > lFrom;
+    double lNinety = lFrom + 0.9 * (lTarget - lFrom);
+    double lWorst = 0;
+    lPoint.ticks = 0;
+    lPoint.t90Ticks = 0;
+    while(lEnvelope.mAdsrStatus == lSegment && lPoint.ticks < lLimit)
+    {
+        lEnvelope.updateOutput();
+        lPoint.ticks++;
+        double lOut = lEnvelope.mEnvelopeOutput;
+        if(!lPoint.t90Ticks && (lRising ? lOut >= lNinety : lOut <= lNinety))
+        {
+            lPoint.t90Ticks = lPoint.ticks;
+        }
+        double lPast = lRising ? lOut - lTarget : lTarget - lOut;
+        lWorst = lPast > lWorst ? lPast : lWorst;
+    }
+    lPoint.overshoot = lWorst;
+    lPoint.done = 1;
+}
+
+static void measureEnvelope(int lSegment, int lKnob, int lVelocity, int lSustain)
+{
+    EnvelopeGenerator lEnvelope;
+    lEnvelope.setAttackKnob(lKnob);
+    lEnvelope.setDecayKnob(lKnob);
+    lEnvelope.setReleaseKnob(lKnob);
+    lEnvelope.setSustainKnob(lSustain);
+    lEnvelope.setVelocity(lVelocity);
+    double lPeak = lVelocity * lEnvelope.mTlcScalar;
+    SweepPoint &lPoint = point(lSegment, lKnob, lVelocity - 1);
+    lPoint.nominalTicks = lKnob * lEnvelope.mTimeScalar + 1;
+
+    switch(lSegment)
+    {
+        case SEG_ATTACK:
+            lEnvelope.setAdsrState(ATTACK_STATE);
+            runEnvelope(lEnvelope, ATTACK_STATE, 300, lPeak, lPoint);   //updateOutput() starts an attack from 300
+            break;
+        case SEG_DECAY:
+            // straight from the end of the attack
+            lEnvelope.mAttackLinearParameters.mFinalAmplitude = lPeak;
+            lEnvelope.mEnvelopeOutput = lPeak;
+            lEnvelope.setAdsrState(DECAY_STATE);
+            runEnvelope(lEnvelope, DECAY_STATE, lPeak, static_cast<unsigned int>(lPeak * (double)lSustain / 1023), lPoint);
+            break;
+        default:
+            // from a full sustain
+            lEnvelope.mEnvelopeOutput = lPeak;
+            lEnvelope.mFirstReleaseIteration = true;
+            lEnvelope.setAdsrState(RELEASE_STATE);
+            runEnvelope(lEnvelope, RELEASE_STATE, lPeak, 0, lPoint);
+            break;
+    }
+}
+
+static void measureGlide(int lKnob, int lInterval)
+{
+    PitchGenerator lPitch;
+    lPitch.setGlideLength(0);
+    lPitch.calculateOutPitch(SWEEP_GLIDE_FROM, SUSTAIN_STATE);
+    lPitch.calculateOutPitch(SWEEP_GLIDE_FROM, SUSTAIN_STATE);
+    lPitch.setGlideLength(lKnob);
+
+    SweepPoint &lPoint = point(SEG_GLIDE, lKnob, lInterval - 1);
+    lPoint.nominalTicks = lKnob > 0 ? lKnob : 1;
+    uint32_t lLimit = lPoint.nominalTicks * 4 + 1000;
+    double lFrom = lPitch.mOutPitch;
+    double lTarget = lPitch.calculatePitchBendTlc(SWEEP_GLIDE_FROM + lInterval);
+    double lNinety = lFrom + 0.9 * (lTarget - lFrom);
+    double lWorst = 0;
+    lPoint.ticks = 0;
+    lPoint.t90Ticks = 0;
+    do
+    {
+        lPitch.calculateOutPitch(SWEEP_GLIDE_FROM + lInterval, SUSTAIN_STATE);
+        lPoint.ticks++;
+        if(!lPoint.t90Ticks && lPitch.mOutPitch >= lNinety)
+        {
+            lPoint.t90Ticks = lPoint.ticks;
+        }
+        lWorst = lPitch.mOutPitch - lTarget > lWorst ? lPitch.mOutPitch - lTarget : lWorst;
+    }
+    while(lPitch.mDoNewGlide && lPoint.ticks < lLimit);
+    lPoint.overshoot = lWorst / (1 << pitchFractionBits);
+    lPoint.done = 1;
+}
+
+// every lJobs-th knob from lFirst, so each worker gets a fair share of the long ones at the top
+static void sweep(int lFirst, int lJobs, int lKnobStep, int lVelocityStep, int lSustain)
+{
+    for(int lKnob = lFirst * lKnobStep; lKnob < SWEEP_KNOBS; lKnob += lJobs * lKnobStep)
+    {
+        for(int lSegment = SEG_ATTACK; lSegment <= SEG_RELEASE; lSegment++)
+        {
+            for(int lVelocity = SWEEP_VELOCITIES; lVelocity >= 1; lVelocity -= lVelocityStep)
+            {
+                measureEnvelope(lSegment, lKnob, lVelocity, lSustain);
+            }
+        }
+        for(int lInterval = 1; lInterval <= SWEEP_INTERVALS; lInterval++)
+        {
+            measureGlide(lKnob, lInterval);
+        }
+    }
+}
+
+/********************output***********************************/
+
+static void writeCsv(FILE *lFile, double lMsPerTick)
+{
+    fprintf(lFile, "segment,knob,velocity_or_interval,ticks,ms,t90_ms,nominal_ms,accuracy,overshoot\n");
+    for(int lSegment = 0; lSegment < NUM_SEGMENTS; lSegment++)
+    {
+        for(int lKnob = 0; lKnob < SWEEP_KNOBS; lKnob++)
+        {
+            for(int lAxis = 0; lAxis < axisLength(lSegment); lAxis++)
+            {
+                const SweepPoint &lPoint = point(lSegment, lKnob, lAxis);
+                if(!lPoint.done)
+                {
+                    continue;
+                }
+                fprintf(lFile, "%s,%d,%d,%u,%.3f,%.3f,%.3f,%.4f,%.1f\n", gSegmentNames[lSegment], lKnob, lAxis + 1, lPoint.ticks,
+                    lPoint.ticks * lMsPerTick, lPoint.t90Ticks * lMsPerTick, lPoint.nominalTicks * lMsPerTick,
+                    (double)lPoint.ticks / lPoint.nominalTicks, lPoint.overshoot);
+            }
+        }
+    }
+}
+
+// one row per SWEEP_SUMMARY_STEP knob values at full velocity (or an octave of glide), with the spread over the
+// other velocities/intervals. ms/knob is the slope since the row above: a straight line keeps it constant
+static void writeSummary(double lMsPerTick, int lKnobStep)
+{
+    for(int lSegment = 0; lSegment < NUM_SEGMENTS; lSegment++)
+    {
+        int lReference = (lSegment == SEG_GLIDE ? SWEEP_SUMMARY_INTERVAL : SWEEP_SUMMARY_VELOCITY) - 1;
+        printf("%s at %s %d\n", gSegmentNames[lSegment], lSegment == SEG_GLIDE ? "interval" : "velocity", lReference + 1);
+        printf("%6s %10s %10s %10s %9s %9s %21s %10s\n", "knob", "ms", "t90 ms", "nominal", "accuracy", "ms/knob",
+            "ms over all", "overshoot");
+        int lLastKnob = -1;
+        double lLastMs = 0;
+        int lStep = SWEEP_SUMMARY_STEP < lKnobStep ? lKnobStep : SWEEP_SUMMARY_STEP - SWEEP_SUMMARY_STEP % lKnobStep;
+        for(int lKnob = 0; lKnob < SWEEP_KNOBS; lKnob += lStep)
+        {
+            // the top row is the last knob value that was swept
+            if(lKnob + lStep >= SWEEP_KNOBS)
+            {
+                lKnob = (SWEEP_KNOBS - 1) - (SWEEP_KNOBS - 1) % lKnobStep;
+            }
+            const SweepPoint &lPoint = point(lSegment, lKnob, lReference);
+            if(!lPoint.done)
+            {
+                continue;
+            }
+            double lMin = -1, lMax = 0, lWorst = 0;
+            for(int lAxis = 0; lAxis < axisLength(lSegment); lAxis++)
+            {
+                const SweepPoint &lOther = point(lSegment, lKnob, lAxis);
+                if(!lOther.done)
+                {
+                    continue;
+                }
+                double lMs = lOther.ticks * lMsPerTick;
+                lMin = (lMin < 0 || lMs < lMin) ? lMs : lMin;
+                lMax = lMs > lMax ? lMs : lMax;
+                lWorst = lOther.overshoot > lWorst ? lOther.overshoot : lWorst;
+            }
+            double lMs = lPoint.ticks * lMsPerTick;
+            char lSpread[32];
+            snprintf(lSpread, sizeof(lSpread), "%.1f - %.1f", lMin, lMax);
+            char lSlope[16] = "-";
+            if(lLastKnob >= 0)
+            {
+                snprintf(lSlope, sizeof(lSlope), "%.3f", (lMs - lLastMs) / (lKnob - lLastKnob));
+            }
+            printf("%6d %10.1f %10.1f %10.1f %9.3f %9s %21s %10.1f\n", lKnob, lMs, lPoint.t90Ticks * lMsPerTick,
+                lPoint.nominalTicks * lMsPerTick, (double)lPoint.ticks / lPoint.nominalTicks, lSlope, lSpread, lWorst);
+            lLastKnob = lKnob;
+            lLastMs = lMs;
+        }
+        printf("\n");
+    }
+}
+
+static void usage(const char *lName)
+{
+    fprintf(stderr, "usage: %s [-j jobs] [-l loop us] [-s sustain knob] [-k knob step] [-v velocity step] [-o sweep.csv]\n", lName);
+}
+
+int main(int argc, char **argv)
+{
+    long lJobs = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned long lLoopUs = HOST_DEFAULT_LOOP_US;
+    int lSustain = 0;
+    int lKnobStep = 1;
+    int lVelocityStep = 1;
+    const char *lOutPath = NULL;
+
+    int lOpt;
+    while((lOpt = getopt(argc, argv, "j:l:s:k:v:o:")) != -1)
+    {
+        switch(lOpt)
+        {
+            case 'j': lJobs = atol(optarg); break;
+            case 'l': lLoopUs = atol(optarg); break;
+            case 's': lSustain = atoi(optarg); break;
+            case 'k': lKnobStep = atoi(optarg); break;
+            case 'v': lVelocityStep = atoi(optarg); break;
+            case 'o': lOutPath = optarg; break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if(optind != argc || lKnobStep < 1 || lVelocityStep < 1 || lSustain < 0 || lSustain > 1023)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    lJobs = lJobs < 1 ? 1 : lJobs;
+    double lMsPerTick = lLoopUs / 1000.0;
+
+    // anonymous shared memory is zeroed, so every point starts out not done
+    size_t lTableBytes = sizeof(SweepPoint) * NUM_SEGMENTS * SWEEP_KNOBS * SWEEP_AXIS;
+    gTable = static_cast<SweepPoint *>(mmap(NULL, lTableBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+    if(gTable == MAP_FAILED)
+    {
+        perror("mmap");
+        return 2;
+    }
+
+    fflush(stdout);
+    for(long j = 0; j < lJobs; j++)
+    {
+        pid_t lPid = fork();
+        if(lPid < 0)
+        {
+            perror("fork");
+            return 2;
+        }
+        if(lPid == 0)
+        {
+            sweep(j, lJobs, lKnobStep, lVelocityStep, lSustain);
+            _exit(0);
+        }
+    }
+    bool lFailed = false;
+    int lStatus;
+    while(wait(&lStatus) > 0)
+    {
+        lFailed = lFailed || !WIFEXITED(lStatus) || WEXITSTATUS(lStatus) != 0;
+    }
+    if(lFailed)
+    {
+        fprintf(stderr, "a worker crashed, the table is incomplete\n");
+    }
+
+    writeSummary(lMsPerTick, lKnobStep);
+    if(lOutPath)
+    {
+        FILE *lFile = fopen(lOutPath, "w");
+        if(!lFile)
+        {
+            fprintf(stderr, "can't write %s\n", lOutPath);
+            return 1;
+        }
+        writeCsv(lFile, lMsPerTick);
+        fclose(lFile);
+    }
+    return lFailed ? 1 : 0;
+}
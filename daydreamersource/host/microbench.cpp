@@ -0,0 +1,591 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it
+*   under the terms of the GNU General Public License as published by the Free Software Foundation,
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/*
+ *  engine microbenchmarks
+ *  times the classes loop() and the TIMER0 interrupt lean on, one call at a time, in the states that cost the most
+ *  or that a change is most likely to move: six voices in attack, a glide under way, sine and square LFO,
+ *  a full gMidiBuffer-sized queue, the byte parser fed note ons and offs.
+ *
+ *  each case is run in batches long enough to time (-t ms), -r times, and the fastest batch is kept.
+ *  instructions come from the CPU's retired instruction counter (perf_event_open), so they don't move with
+ *  clock speed or a busy machine the way ns do. they are null where the kernel won't give us the counter.
+ *  these are host numbers: the ATmega328P is a different machine, but a change that makes one of these
+ *  slower on the host nearly always does on the board as well.
+ *
+ *  results are JSON, one case per line, so two runs can be diffed. batch sizes are left out of it since they change every run.
+ *
+ *  build:  g++ -O2 -std=gnu++11 -DHOST_BUILD -Idaydreamersource/host/arduino -Idaydreamersource -o microbench \
+ *              daydreamersource/host/microbench.cpp daydreamersource/host/hostsketch.cpp daydreamersource/[a-z]*.cpp
+ *  run:    ./microbench [-t batch ms] [-r repeats] [-f filter] [-o out.json]
+ *          -f      only the cases whose name contains this
+ *          -o      write the JSON here and print a table instead
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "hostsketch.h"
+#include "../envelopegenerator.h"
+#include "../pitchgenerator.h"
+#include "../lfogenerator.h"
+#include "../modmatrix.h"
+#include "../queue.h"
+
+#define BENCH_QUEUE_SIZE 60         //gMidiBuffer
+#define BENCH_MIN_OPS 1000
+#define BENCH_CALIBRATE_OPS 10000
+
+typedef struct BenchCase
+{
+    const char *name;
+    const char *state;
+    void (*setup)();
+    void (*run)(unsigned long lOps);
+} BenchCase;
+
+typedef struct BenchResult
+{
+    unsigned long ops;
+    double nsPerOp;
+    double instructionsPerOp;   //negative without the counter
+} BenchResult;
+
+// everything a case works out goes in here so the compiler can't throw the work away
+static volatile unsigned long gSink;
+
+static EnvelopeGenerator gBenchEnvelopes[NUM_VOICES];
+static PitchGenerator gBenchPitch;
+static LfoGenerator gBenchLfo;
+static ModMatrix gBenchMatrix;
+static Queue gBenchQueue(BENCH_QUEUE_SIZE);
+static int gBenchLinear;
+static uint8_t gBenchMidiByte;
+
+/********************the cases***********************************/
+
+static void setupEnvelopeAttack()
+{
+    for(uint8_t lVoice = 0; lVoice < NUM_VOICES; lVoice++)
+    {
+        gBenchEnvelopes[lVoice].setVoice(lVoice);
+        gBenchEnvelopes[lVoice].setAttackKnob(1023);
+        gBenchEnvelopes[lVoice].setDecayKnob(512);
+        gBenchEnvelopes[lVoice].setSustainKnob(700);
+        gBenchEnvelopes[lVoice].setReleaseKnob(512);
+        gBenchEnvelopes[lVoice].setVelocity(100);
+        gBenchEnvelopes[lVoice].setAdsrState(ATTACK_STATE);
+    }
+}
+
+// one op is one voice's update, round the six. a voice that finishes its attack starts another
+static void runEnvelopeAttack(unsigned long lOps)
+{
+    unsigned long lSum = 0;
+    uint8_t lVoice = 0;
+    for(unsigned long i = 0; i < lOps; i++)
+    {
+        EnvelopeGenerator &lEnvelope = gBenchEnvelopes[lVoice];
+        lSum += lEnvelope.updateOutput();
+        if(lEnvelope.mAdsrStatus != ATTACK_STATE)
+        {
+            lEnvelope.setAdsrState(ATTACK_STATE);
+        }
+        lVoice = lVoice == NUM_VOICES - 1 ? 0 : lVoice + 1;
+    }
+    gSink += lSum;
+}
+
+static void setupEnvelopeRelease()
+{
+    setupEnvelopeAttack();
+    for(uint8_t lVoice = 0; lVoice < NUM_VOICES; lVoice++)
+    {
+        gBenchEnvelopes[lVoice].setReleaseKnob(1023);
+        gBenchEnvelopes[lVoice].mEnvelopeOutput = 4000;
+        gBenchEnvelopes[lVoice].setAdsrState(RELEASE_STATE);
+    }
+}
+
+static void runEnvelopeRelease(unsigned long lOps)
+{
+    unsigned long lSum = 0;
+    uint8_t lVoice = 0;
+    for(unsigned long i = 0; i < lOps; i++)
+    {
+        EnvelopeGenerator &lEnvelope = gBenchEnvelopes[lVoice];
+        lSum += lEnvelope.updateOutput();
+        if(lEnvelope.mAdsrStatus != RELEASE_STATE)
+        {
+            lEnvelope.mEnvelopeOutput = 4000;
+            lEnvelope.setAdsrState(RELEASE_STATE);
+        }
+        lVoice = lVoice == NUM_VOICES - 1 ? 0 : lVoice + 1;
+    }
+    gSink += lSum;
+}
+
+static void setupEnvelopeSustain()
+{
+    setupEnvelopeAttack();
+    for(uint8_t lVoice = 0; lVoice < NUM_VOICES; lVoice++)
+    {
+        gBenchEnvelopes[lVoice].setAdsrState(SUSTAIN_STATE);
+    }
+}
+
+static void runEnvelopeSustain(unsigned long lOps)
+{
+    unsigned long lSum = 0;
+    uint8_t lVoice = 0;
+    for(unsigned long i = 0; i < lOps; i++)
+    {
+        lSum += gBenchEnvelopes[lVoice].updateOutput();
+        lVoice = lVoice == NUM_VOICES - 1 ? 0 : lVoice + 1;
+    }
+    gSink += lSum;
+}
+
+static void setupPitchHeld()
+{
+    gBenchPitch = PitchGenerator();
+    gBenchPitch.setGlideLength(0);
+    gBenchPitch.calculateOutPitch(60, SUSTAIN_STATE);
+}
+
+static void runPitchHeld(unsigned long lOps)
+{
+    unsigned long lSum = 0;
+    for(unsigned long i = 0; i < lOps; i++)
+    {
+        lSum += gBenchPitch.calculateOutPitch(60, SUSTAIN_STATE);
+    }
+    gSink += lSum;
+}
+
+static void setupPitchGlide()
+{
+    gBenchPitch = PitchGenerator();
+    gBenchPitch.setGlideLength(1023);
+    gBenchMidiByte = 48;
+}
+
+// jumps between two notes an octave apart, starting the next glide as soon as the last one lands
+static void runPitchGlide(unsigned long lOps)
+{
+    unsigned long lSum = 0;
+    for(unsigned long i = 0; i < lOps; i++)
+    {
+        if(!gBenchPitch.mDoNewGlide)
+        {
+            gBenchMidiByte = gBenchMidiByte == 48 ? 60 : 48;
+        }
+        lSum += gBenchPitch.calculateOutPitch(gBenchMidiByte, SUSTAIN_STATE);
+    }
+    gSink += lSum;
+}
+
+static void setupPitchBend()
+{
+    gBenchPitch = PitchGenerator();
+    gBenchPitch.mPitchAndLfoBend = 0;
+}
+
+// a bend that sweeps two semitones either way, so most calls interpolate
+static void runPitchBend(unsigned long lOps)
+{
+    unsigned long lSum = 0;
+    int lBend = gBenchPitch.mPitchAndLfoBend;
+    for(unsigned long i = 0; i < lOps; i++)
+    {
+        lBend = lBend >= 2 * pitchBendIncrements ? -2 * pitchBendIncrements : lBend + 3;
+        gBenchPitch.mPitchAndLfoBend = lBend;
+        lSum += gBenchPitch.calculatePitchBendTlc(60);
+    }
+    gBenchPitch.mPitchAndLfoBend = lBend;
+    gSink += lSum;
+}
+
+static void setupLfoSine()
+{
+    gBenchLfo = LfoGenerator();
+    gBenchLfo.setVoicePhaseSpread(10923);
+    gBenchLfo.setLfoRecordLength(900);
+    gBenchLfo.setSineOrSquare(true);
+}
+
+static void setupLfoSquare()
+{
+    setupLfoSine();
+    gBenchLfo.setSineOrSquare(false);
+}
+
+static void runLfo(unsigned long lOps)
+{
+    unsigned long lSum = 0;
+    for(unsigned long i = 0; i < lOps; i++)
+    {
+        gBenchLfo.calculateModulation();
+        lSum += gBenchLfo.mVoiceWave[NUM_VOICES - 1];
+    }
+    gSink += lSum;
+}
+
+static void setupLog()
+{
+    gBenchLinear = 0;
+}
+
+static void runLog(unsigned long lOps)
+{
+    unsigned long lSum = 0;
+    int lLinear = gBenchLinear;
+    for(unsigned long i = 0; i < lOps; i++)
+    {
+        lLinear = (lLinear + 7) & 1023;
+        lSum += calculateLogFromLinear(lLinear);
+    }
+    gBenchLinear = lLinear;
+    gSink += lSum;
+}
+
+static void emptyQueue()
+{
+    while(!gBenchQueue.isEmpty())
+    {
+        gBenchQueue.pop();
+    }
+}
+
+static void setupQueueEmpty()
+{
+    emptyQueue();
+}
+
+static void setupQueueFull()
+{
+    emptyQueue();
+    while(!gBenchQueue.isFull())
+    {
+        gBenchQueue.push(0x90);
+    }
+}
+
+// one op is a push and a pop, so the depth stays where the setup left it.
+// full pops first, so it is the push into the slot that just came free
+static void runQueueEmpty(unsigned long lOps)
+{
+    unsigned long lSum = 0;
+    for(unsigned long i = 0; i < lOps; i++)
+    {
+        gBenchQueue.push(i & 0x7F);
+        lSum += gBenchQueue.pop();
+    }
+    gSink += lSum;
+}
+
+static void runQueueFull(unsigned long lOps)
+{
+    unsigned long lSum = 0;
+    for(unsigned long i = 0; i < lOps; i++)
+    {
+        lSum += gBenchQueue.pop();
+        gBenchQueue.push(i & 0x7F);
+    }
+    gSink += lSum;
+}
+
+// a push that is dropped because the queue is full, what checkMidi() does when loop() falls behind
+static void runQueueOverflow(unsigned long lOps)
+{
+    for(unsigned long i = 0; i < lOps; i++)
+    {
+        gBenchQueue.push(i & 0x7F);
+    }
+    gSink += gBenchQueue.size();
+}
+
+static void setupParser()
+{
+    hostBegin();
+}
+
+// one op is one byte of a note on / note off stream on channel 1, notes walking up the keyboard
+static void runParser(unsigned long lOps)
+{
+    static const uint8_t lStatuses[2] = {0x90, 0x80};
+    static uint8_t lStep = 0;
+    static uint8_t lNote = 36;
+    for(unsigned long i = 0; i < lOps; i++)
+    {
+        uint8_t lMessage = lStep / 3;
+        switch(lStep % 3)
+        {
+            case 0: hostParseMidi(lStatuses[lMessage]); break;
+            case 1: hostParseMidi(lNote); break;
+            default: hostParseMidi(100); break;
+        }
+        if(++lStep == 6)
+        {
+            lStep = 0;
+            lNote = lNote == 96 ? 36 : lNote + 1;
+        }
+    }
+}
+
+static void setupMatrix()
+{
+    gBenchMatrix = ModMatrix();
+    gBenchMatrix.setDepth(MOD_ROUTE_PANEL_VCO, 64);
+    gBenchMatrix.setDepth(MOD_ROUTE_PANEL_VCF, -64);
+    gBenchMatrix.setRoute(MOD_ROUTE_USER_FIRST, MOD_SRC_VELOCITY, MOD_DST_VCA, 32);
+    gBenchLfo = LfoGenerator();
+    gBenchLfo.setVoicePhaseSpread(10923);
+    gBenchLfo.setLfoRecordLength(1023);
+}
+
+// what loop() does with the matrix every pass: new LFO values for every voice, then update()
+static void runMatrix(unsigned long lOps)
+{
+    unsigned long lSum = 0;
+    for(unsigned long i = 0; i < lOps; i++)
+    {
+        gBenchLfo.calculateModulation();
+        for(uint8_t lVoice = 0; lVoice < NUM_VOICES; lVoice++)
+        {
+            gBenchMatrix.setSource(MOD_SRC_LFO, lVoice, gBenchLfo.mVoiceWave[lVoice]);
+        }
+        gBenchMatrix.setSource(MOD_SRC_LFO, MOD_GLOBAL, gBenchLfo.mWave);
+        gBenchMatrix.update();
+        lSum += gBenchMatrix.output(MOD_DST_PITCH, 0);
+    }
+    gSink += lSum;
+}
+
+static const BenchCase gCases[] = {
+    {"EnvelopeGenerator::updateOutput", "6 voices in attack", setupEnvelopeAttack, runEnvelopeAttack},
+    {"EnvelopeGenerator::updateOutput", "6 voices in release", setupEnvelopeRelease, runEnvelopeRelease},
+    {"EnvelopeGenerator::updateOutput", "6 voices in sustain", setupEnvelopeSustain, runEnvelopeSustain},
+    {"PitchGenerator::calculateOutPitch", "note held", setupPitchHeld, runPitchHeld},
+    {"PitchGenerator::calculateOutPitch", "glide active", setupPitchGlide, runPitchGlide},
+    {"PitchGenerator::calculatePitchBendTlc", "bend sweeping", setupPitchBend, runPitchBend},
+    {"LfoGenerator::calculateModulation", "sine", setupLfoSine, runLfo},
+    {"LfoGenerator::calculateModulation", "square", setupLfoSquare, runLfo},
+    {"calculateLogFromLinear", "sweep", setupLog, runLog},
+    {"Queue::push+pop", "empty", setupQueueEmpty, runQueueEmpty},
+    {"Queue::push+pop", "full", setupQueueFull, runQueueFull},
+    {"Queue::push", "full, dropped", setupQueueFull, runQueueOverflow},
+    {"parseMidiByte", "note on/off bytes", setupParser, runParser},
+    {"ModMatrix::update", "LFO to pitch and LPF, 6 voices", setupMatrix, runMatrix},
+};
+
+#define NUM_CASES (sizeof(gCases) / sizeof(gCases[0]))
+
+/********************timing***********************************/
+
+static int gInstructionCounter = -1;
+
+static void openInstructionCounter()
+{
+    struct perf_event_attr lAttr;
+    memset(&lAttr, 0, sizeof(lAttr));
+    lAttr.type = PERF_TYPE_HARDWARE;
+    lAttr.size = sizeof(lAttr);
+    lAttr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    lAttr.disabled = 1;
+    lAttr.exclude_kernel = 1;
+    lAttr.exclude_hv = 1;
+    gInstructionCounter = syscall(__NR_perf_event_open, &lAttr, 0, -1, -1, 0);
+}
+
+static double nowNs()
+{
+    struct timespec lNow;
+    clock_gettime(CLOCK_MONOTONIC, &lNow);
+    return lNow.tv_sec * 1e9 + lNow.tv_nsec;
+}
+
+// one batch of lOps. the instruction count includes the batch loop itself, which is part of every op anyway
+static void runBatch(const BenchCase &lCase, unsigned long lOps, double &lNs, long long &lInstructions)
+{
+    lInstructions = -1;
+    if(gInstructionCounter >= 0)
+    {
+        ioctl(gInstructionCounter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(gInstructionCounter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    double lStart = nowNs();
+    lCase.run(lOps);
+    lNs = nowNs() - lStart;
+    if(gInstructionCounter >= 0)
+    {
+        ioctl(gInstructionCounter, PERF_EVENT_IOC_DISABLE, 0);
+        if(read(gInstructionCounter, &lInstructions, sizeof(lInstructions)) != sizeof(lInstructions))
+        {
+            lInstructions = -1;
+        }
+    }
+}
+
+static BenchResult runCase(const BenchCase &lCase, double lBatchMs, int lRepeats)
+{
+    lCase.setup();
+
+    // size the batch from a short warm up run
+    double lNs;
+    long long lInstructions;
+    runBatch(lCase, BENCH_CALIBRATE_OPS, lNs, lInstructions);
+    double lOps = lBatchMs * 1e6 / (lNs > 0 ? lNs / BENCH_CALIBRATE_OPS : 1.0);
+    BenchResult lResult;
+    lResult.ops = lOps < BENCH_MIN_OPS ? BENCH_MIN_OPS : static_cast<unsigned long>(lOps);
+    lResult.nsPerOp = -1;
+    lResult.instructionsPerOp = -1;
+
+    for(int r = 0; r < lRepeats; r++)
+    {
+        runBatch(lCase, lResult.ops, lNs, lInstructions);
+        double lNsPerOp = lNs / lResult.ops;
+        if(lResult.nsPerOp < 0 || lNsPerOp < lResult.nsPerOp)
+        {
+            lResult.nsPerOp = lNsPerOp;
+        }
+        double lInstructionsPerOp = lInstructions >= 0 ? (double)lInstructions / lResult.ops : -1;
+        if(lInstructionsPerOp >= 0 && (lResult.instructionsPerOp < 0 || lInstructionsPerOp < lResult.instructionsPerOp))
+        {
+            lResult.instructionsPerOp = lInstructionsPerOp;
+        }
+    }
+    return lResult;
+}
+
+/********************output***********************************/
+
+static void writeJson(FILE *lFile, const bool *lSelected, const BenchResult *lResults, double lBatchMs, int lRepeats)
+{
+    fprintf(lFile, "{\n  \"tool\": \"microbench\",\n  \"batchMs\": %.0f,\n  \"repeats\": %d,\n  \"instructionCounter\": %s,\n  \"results\": [\n",
+        lBatchMs, lRepeats, gInstructionCounter >= 0 ? "true" : "false");
+    bool lFirst = true;
+    for(unsigned int i = 0; i < NUM_CASES; i++)
+    {
+        if(!lSelected[i])
+        {
+            continue;
+        }
+        fprintf(lFile, "%s    {\"name\": \"%s\", \"state\": \"%s\", \"nsPerOp\": %.2f, \"instructionsPerOp\": ",
+            lFirst ? "" : ",\n", gCases[i].name, gCases[i].state, lResults[i].nsPerOp);
+        if(lResults[i].instructionsPerOp >= 0)
+        {
+            fprintf(lFile, "%.1f}", lResults[i].instructionsPerOp);
+        }
+        else
+        {
+            fprintf(lFile, "null}");
+        }
+        lFirst = false;
+    }
+    fprintf(lFile, "\n  ]\n}\n");
+}
+
+static void writeTable(const bool *lSelected, const BenchResult *lResults)
+{
+    printf("%-40s %-32s %10s %12s\n", "case", "state", "ns/op", "instr/op");
+    for(unsigned int i = 0; i < NUM_CASES; i++)
+    {
+        if(!lSelected[i])
+        {
+            continue;
+        }
+        printf("%-40s %-32s %10.2f ", gCases[i].name, gCases[i].state, lResults[i].nsPerOp);
+        if(lResults[i].instructionsPerOp >= 0)
+        {
+            printf("%12.1f\n", lResults[i].instructionsPerOp);
+        }
+        else
+        {
+            printf("%12s\n", "-");
+        }
+    }
+}
+
+static void usage(const char *lName)
+{
+    fprintf(stderr, "usage: %s [-t batch ms] [-r repeats] [-f filter] [-o out.json]\n", lName);
+}
+
+int main(int argc, char **argv)
+{
+    double lBatchMs = 20;
+    int lRepeats = 5;
+    const char *lFilter = NULL;
+    const char *lOutPath = NULL;
+
+    int lOpt;
+    while((lOpt = getopt(argc, argv, "t:r:f:o:")) != -1)
+    {
+        switch(lOpt)
+        {
+            case 't': lBatchMs = atof(optarg); break;
+            case 'r': lRepeats = atoi(optarg); break;
+            case 'f': lFilter = optarg; break;
+            case 'o': lOutPath = optarg; break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if(optind != argc || lBatchMs <= 0 || lRepeats < 1)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    openInstructionCounter();
+    if(gInstructionCounter < 0)
+    {
+        fprintf(stderr, "no instruction counter (perf_event_open), instructionsPerOp will be null\n");
+    }
+
+    bool lSelected[NUM_CASES];
+    BenchResult lResults[NUM_CASES];
+    for(unsigned int i = 0; i < NUM_CASES; i++)
+    {
+        lSelected[i] = !lFilter || strstr(gCases[i].name, lFilter) != NULL;
+        if(lSelected[i])
+        {
+            lResults[i] = runCase(gCases[i], lBatchMs, lRepeats);
+        }
+    }
+
+    if(!lOutPath)
+    {
+        writeJson(stdout, lSelected, lResults, lBatchMs, lRepeats);
+        return 0;
+    }
+    FILE *lFile = fopen(lOutPath, "w");
+    if(!lFile)
+    {
+        fprintf(stderr, "can't write %s\n", lOutPath);
+        return 1;
+    }
+    writeJson(lFile, lSelected, lResults, lBatchMs, lRepeats);
+    fclose(lFile);
+    writeTable(lSelected, lResults);
+    return 0;
+}
@@ -0,0 +1,292 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "midifile.h"
+#include "hostsketch.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+typedef struct TrackEvent
+{
+    unsigned long tick;
+    unsigned long order;    //keeps events on the same tick in file order
+    unsigned long tempo;    //microseconds per quarter note, 0 for anything that isn't a tempo change
+    std::vector<uint8_t> bytes;
+} TrackEvent;
+
+static bool compareTrackEvents(const TrackEvent &a, const TrackEvent &b)
+{
+    return a.tick != b.tick ? a.tick < b.tick : a.order < b.order;
+}
+
+static unsigned long readBigEndian(const std::vector<uint8_t> &lData, size_t lPos, int lBytes)
+{
+    unsigned long lValue = 0;
+    for(int i = 0; i < lBytes; i++)
+    {
+        lValue = (lValue << 8) | lData[lPos + i];
+    }
+    return lValue;
+}
+
+static bool readVariableLength(const std::vector<uint8_t> &lData, size_t &lPos, size_t lEnd, unsigned long &lValue)
+{
+    lValue = 0;
+    for(int i = 0; i < 4; i++)
+    {
+        if(lPos >= lEnd)
+        {
+            return false;
+        }
+        uint8_t lByte = lData[lPos++];
+        lValue = (lValue << 7) | (lByte & 0x7F);
+        if(!(lByte & 0x80))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int channelMessageLength(uint8_t lStatus)
+{
+    switch(lStatus & 0xF0)
+    {
+        case 0xC0:
+        case 0xD0:
+            return 2;
+        default:
+            return 3;
+    }
+}
+
+static bool parseTrack(const std::vector<uint8_t> &lData, size_t lPos, size_t lEnd, int lChannel,
+    std::vector<TrackEvent> &lOut, unsigned long &lOrder, std::string &lError)
+{
+    unsigned long lTick = 0;
+    uint8_t lRunningStatus = 0;
+    while(lPos < lEnd)
+    {
+        unsigned long lDelta;
+        if(!readVariableLength(lData, lPos, lEnd, lDelta) || lPos >= lEnd)
+        {
+            lError = "truncated track";
+            return false;
+        }
+        lTick += lDelta;
+
+        TrackEvent lEvent;
+        lEvent.tick = lTick;
+        lEvent.order = lOrder++;
+        lEvent.tempo = 0;
+
+        uint8_t lStatus = lData[lPos];
+        if(lStatus == 0xFF)
+        {
+            // meta event. only tempo matters here
+            if(lPos + 2 > lEnd)
+            {
+                lError = "truncated meta event";
+                return false;
+            }
+            uint8_t lType = lData[lPos + 1];
+            lPos += 2;
+            unsigned long lLength;
+            if(!readVariableLength(lData, lPos, lEnd, lLength) || lPos + lLength > lEnd)
+            {
+                lError = "truncated meta event";
+                return false;
+            }
+            if(lType == 0x51 && lLength == 3)
+            {
+                lEvent.tempo = readBigEndian(lData, lPos, 3);
+                lOut.push_back(lEvent);
+            }
+            lPos += lLength;
+            if(lType == 0x2F)
+            {
+                break;
+            }
+        }
+        else if(lStatus == 0xF0 || lStatus == 0xF7)
+        {
+            // F0 <length> <data> is a whole sysex, F7 <length> <data> is raw bytes
+            lPos++;
+            unsigned long lLength;
+            if(!readVariableLength(lData, lPos, lEnd, lLength) || lPos + lLength > lEnd)
+            {
+                lError = "truncated sysex";
+                return false;
+            }
+            if(lStatus == 0xF0)
+            {
+                lEvent.bytes.push_back(0xF0);
+            }
+            lEvent.bytes.insert(lEvent.bytes.end(), lData.begin() + lPos, lData.begin() + lPos + lLength);
+            lPos += lLength;
+            lRunningStatus = 0;
+            lOut.push_back(lEvent);
+        }
+        else
+        {
+            if(lStatus & 0x80)
+            {
+                lRunningStatus = lStatus;
+                lPos++;
+            }
+            else if(!lRunningStatus)
+            {
+                lError = "data byte without a status";
+                return false;
+            }
+            int lLength = channelMessageLength(lRunningStatus);
+            if(lPos + lLength - 1 > lEnd)
+            {
+                lError = "truncated channel message";
+                return false;
+            }
+            uint8_t lOutStatus = lRunningStatus;
+            if(lChannel >= 0)
+            {
+                lOutStatus = (lRunningStatus & 0xF0) | (lChannel & 0x0F);
+            }
+            lEvent.bytes.push_back(lOutStatus);
+            for(int i = 1; i < lLength; i++)
+            {
+                lEvent.bytes.push_back(lData[lPos++]);
+            }
+            lOut.push_back(lEvent);
+        }
+    }
+    return true;
+}
+
+static bool loadStandardMidiFile(const std::vector<uint8_t> &lData, int lChannel, std::vector<MidiEvent> &lEvents, std::string &lError)
+{
+    if(lData.size() < 14 || readBigEndian(lData, 4, 4) < 6)
+    {
+        lError = "bad MThd";
+        return false;
+    }
+    unsigned long lHeaderLength = readBigEndian(lData, 4, 4);
+    unsigned long lTracks = readBigEndian(lData, 10, 2);
+    unsigned long lDivision = readBigEndian(lData, 12, 2);
+
+    std::vector<TrackEvent> lAll;
+    unsigned long lOrder = 0;
+    size_t lPos = 8 + lHeaderLength;
+    for(unsigned long lTrack = 0; lTrack < lTracks && lPos + 8 <= lData.size(); lTrack++)
+    {
+        unsigned long lLength = readBigEndian(lData, lPos + 4, 4);
+        size_t lStart = lPos + 8;
+        size_t lEnd = std::min(lData.size(), static_cast<size_t>(lStart + lLength));
+        if(memcmp(&lData[lPos], "MTrk", 4) == 0 && !parseTrack(lData, lStart, lEnd, lChannel, lAll, lOrder, lError))
+        {
+            return false;
+        }
+        lPos = lStart + lLength;
+    }
+    std::stable_sort(lAll.begin(), lAll.end(), compareTrackEvents);
+
+    // walk the tempo map. SMPTE division has a fixed tick length
+    double lUsPerTick;
+    bool lSmpte = lDivision & 0x8000;
+    if(lSmpte)
+    {
+        int lFps = -static_cast<int8_t>(lDivision >> 8);
+        int lTicksPerFrame = lDivision & 0xFF;
+        lUsPerTick = 1000000.0 / (lFps * lTicksPerFrame);
+    }
+    else
+    {
+        lUsPerTick = 500000.0 / lDivision;     //120 bpm until told otherwise
+    }
+
+    double lTimeUs = 0;
+    unsigned long lLastTick = 0;
+    for(size_t i = 0; i < lAll.size(); i++)
+    {
+        lTimeUs += (lAll[i].tick - lLastTick) * lUsPerTick;
+        lLastTick = lAll[i].tick;
+        if(lAll[i].tempo)
+        {
+            if(!lSmpte)
+            {
+                lUsPerTick = static_cast<double>(lAll[i].tempo) / lDivision;
+            }
+            continue;
+        }
+        MidiEvent lEvent;
+        lEvent.timeUs = static_cast<unsigned long>(lTimeUs);
+        lEvent.bytes = lAll[i].bytes;
+        lEvents.push_back(lEvent);
+    }
+    return true;
+}
+
+bool loadMidiFile(const char *lPath, int lChannel, std::vector<MidiEvent> &lEvents, std::string &lError)
+{
+    FILE *lFile = fopen(lPath, "rb");
+    if(!lFile)
+    {
+        lError = "can't open";
+        return false;
+    }
+    std::vector<uint8_t> lData;
+    int c;
+    while((c = fgetc(lFile)) != EOF)
+    {
+        lData.push_back(static_cast<uint8_t>(c));
+    }
+    fclose(lFile);
+
+    lEvents.clear();
+    if(lData.size() >= 4 && memcmp(&lData[0], "MThd", 4) == 0)
+    {
+        return loadStandardMidiFile(lData, lChannel, lEvents, lError);
+    }
+
+    // raw capture: one event per byte, at wire speed
+    for(size_t i = 0; i < lData.size(); i++)
+    {
+        MidiEvent lEvent;
+        lEvent.timeUs = i * HOST_MIDI_BYTE_US;
+        uint8_t lByte = lData[i];
+        if(lChannel >= 0 && lByte >= 0x80 && lByte < 0xF0)
+        {
+            lByte = (lByte & 0xF0) | (lChannel & 0x0F);
+        }
+        lEvent.bytes.push_back(lByte);
+        lEvents.push_back(lEvent);
+    }
+    return true;
+}
+
+void scheduleMidiBytes(const std::vector<MidiEvent> &lEvents, std::vector<unsigned long> &lTimes, std::vector<uint8_t> &lBytes)
+{
+    unsigned long lWireFree = 0;
+    for(size_t i = 0; i < lEvents.size(); i++)
+    {
+        unsigned long lTime = std::max(lEvents[i].timeUs, lWireFree);
+        for(size_t b = 0; b < lEvents[i].bytes.size(); b++)
+        {
+            lTimes.push_back(lTime);
+            lBytes.push_back(lEvents[i].bytes[b]);
+            lTime += HOST_MIDI_BYTE_US;
+        }
+        lWireFree = lTime;
+    }
+}
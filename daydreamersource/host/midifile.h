@@ -0,0 +1,46 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/*
+ *  loads MIDI for the host tools
+ *  - Standard MIDI Files (format 0 or 1): every track is merged and put through the tempo map
+ *  - anything else is taken as a raw capture of the MIDI wire, one byte every HOST_MIDI_BYTE_US
+ *
+ *  events come out with absolute times and always with their status byte (running status is expanded),
+ *  because the sketch's parser needs a status byte on every message.
+ */
+
+#ifndef MIDIFILE_H
+#define MIDIFILE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+typedef struct MidiEvent
+{
+    unsigned long timeUs;
+    std::vector<uint8_t> bytes;
+} MidiEvent;
+
+// lChannel >= 0 moves every channel message onto that channel, so a multi channel file plays on one synth.
+// returns false and fills lError if the file can't be read
+bool loadMidiFile(const char *lPath, int lChannel, std::vector<MidiEvent> &lEvents, std::string &lError);
+
+// spreads the events out so no two bytes are closer than one byte time on the wire
+// and returns the time each byte arrives at the synth
+void scheduleMidiBytes(const std::vector<MidiEvent> &lEvents, std::vector<unsigned long> &lTimes, std::vector<uint8_t> &lBytes);
+
+#endif // MIDIFILE_H
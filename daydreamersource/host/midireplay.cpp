@@ -0,0 +1,554 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it
+*   under the terms of the GNU General Public License as published by the Free Software Foundation,
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/*
+ *  MIDI corpus replay and stuck note soak
+ *  streams every file through the real getMidiStates()/doMidiStates()/loop() in every POLYPHONY mode.
+ *  each run gets its own forked process so it starts from a clean synth (the sketch keeps state in function statics),
+ *  and the runs are spread over all cores.
+ *
+ *  after the last event it sends sustain off and a note off for every note, lets the synth run for
+ *  -t ms, then reports any voice still in attack, decay or sustain and any note still in gNotesPressed.
+ *
+ *  per run: MIDI events/sec through the engine (host CPU time), peak gMidiBuffer depth, bytes dropped by
+ *  gMidiBuffer or the UART, voice steals, stuck voices and, with -g, a comparison of the TLC outputs
+ *  sampled on every TIMER0 tick against a stored golden trace. any time loop() spent waiting on an
+ *  EEPROM write is added to the end of the line.
+ *
+ *  build:  g++ -O2 -std=gnu++11 -DHOST_BUILD -Idaydreamersource/host/arduino -Idaydreamersource -o midireplay \
+ *              daydreamersource/host/midireplay.cpp daydreamersource/host/hostsketch.cpp \
+ *              daydreamersource/host/midifile.cpp daydreamersource/[a-z]*.cpp
+ *  run:    ./midireplay [-j jobs] [-g golden dir] [-u] [-l loop us] [-t tail ms] [-m modes] [-k] files or directories...
+ *          -u      write the golden traces instead of comparing against them
+ *          -m      comma separated modes, e.g. MONO_1,POLY_3. default is all of them
+ *          -k      keep each file's MIDI channels instead of moving everything onto channel 1.
+ *                  POLY_MPE always keeps them, with channel 1 as the manager of a zone over the other 15
+ *  exits 1 if anything got stuck or a golden trace didn't match.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "hostsketch.h"
+#include "midifile.h"
+
+#define NUM_MODES 8
+#define GOLDEN_MAGIC "DDCV"
+// midiutils.h lives inside hostsketch.cpp, it defines globals
+#define ALL_OFF_SUSTAIN_STATUS  0xB0
+#define ALL_OFF_SUSTAIN_CC      0x40
+#define ALL_OFF_NOTE_OFF_STATUS 0x80
+
+typedef enum {GOLDEN_NONE, GOLDEN_MATCH, GOLDEN_MISMATCH, GOLDEN_MISSING, GOLDEN_WRITTEN} GOLDEN_STATUSES;
+
+const char *gModeNames[NUM_MODES] = {"MONO_1", "MONO_2", "MONO_3", "MONO_6", "POLY_1", "POLY_2", "POLY_3", "POLY_MPE"};
+const char *gGoldenNames[] = {"-", "match", "MISMATCH", "missing", "written"};
+
+// sent back from each child through a pipe, so plain data only
+typedef struct ReplayResult
+{
+    bool ok;
+    char error[64];
+    unsigned long events;
+    unsigned long bytes;
+    double seconds;             //host CPU time for the replay
+    int peakQueueDepth;
+    unsigned long queueDrops;
+    unsigned long rxOverruns;
+    unsigned long steals;
+    double idlePercent;         //share of the file spent quiescent
+    unsigned long wakes;
+    unsigned long eepromStallUs;    //loop() waiting on EEPROM writes, see hostsketch.cpp
+    uint8_t stuckVoices;        //bit per voice still gated after all notes off
+    unsigned int notesStillPressed;
+    GOLDEN_STATUSES golden;
+    unsigned long goldenFrames;
+    unsigned long goldenMismatches;
+    double firstMismatchMs;
+} ReplayResult;
+
+typedef struct ReplayOptions
+{
+    std::string goldenDir;
+    bool updateGolden;
+    unsigned long loopUs;
+    unsigned long tailMs;
+    int channel;                //-1 keeps the file's channels
+} ReplayOptions;
+
+typedef struct ReplayJob
+{
+    std::string path;
+    POLYPHONY mode;
+} ReplayJob;
+
+static std::vector<uint16_t> gCvFrames;
+
+static void captureCvFrame()
+{
+    for(uint8_t lChannel = 0; lChannel < HOST_TLC_USED; lChannel++)
+    {
+        gCvFrames.push_back(hostTlcOutput(lChannel));
+    }
+}
+
+static double cpuSeconds()
+{
+    struct timespec lNow;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &lNow);
+    return lNow.tv_sec + lNow.tv_nsec / 1e9;
+}
+
+static std::string goldenPath(const ReplayOptions &lOptions, const ReplayJob &lJob)
+{
+    std::string lName = lJob.path;
+    size_t lSlash = lName.find_last_of('/');
+    if(lSlash != std::string::npos)
+    {
+        lName = lName.substr(lSlash + 1);
+    }
+    return lOptions.goldenDir + "/" + lName + "." + gModeNames[lJob.mode] + ".cv";
+}
+
+// "DDCV", frame count, channels per frame, then the frames. host byte order
+static bool writeGolden(const std::string &lPath)
+{
+    FILE *lFile = fopen(lPath.c_str(), "wb");
+    if(!lFile)
+    {
+        return false;
+    }
+    uint32_t lFrames = gCvFrames.size() / HOST_TLC_USED;
+    uint16_t lChannels = HOST_TLC_USED;
+    fwrite(GOLDEN_MAGIC, 1, 4, lFile);
+    fwrite(&lFrames, sizeof(lFrames), 1, lFile);
+    fwrite(&lChannels, sizeof(lChannels), 1, lFile);
+    fwrite(gCvFrames.data(), sizeof(uint16_t), gCvFrames.size(), lFile);
+    fclose(lFile);
+    return true;
+}
+
+static void compareGolden(const std::string &lPath, ReplayResult &lResult)
+{
+    FILE *lFile = fopen(lPath.c_str(), "rb");
+    if(!lFile)
+    {
+        lResult.golden = GOLDEN_MISSING;
+        return;
+    }
+    char lMagic[4];
+    uint32_t lFrames = 0;
+    uint16_t lChannels = 0;
+    bool lHeaderOk = fread(lMagic, 1, 4, lFile) == 4 && memcmp(lMagic, GOLDEN_MAGIC, 4) == 0 &&
+        fread(&lFrames, sizeof(lFrames), 1, lFile) == 1 && fread(&lChannels, sizeof(lChannels), 1, lFile) == 1 &&
+        lChannels == HOST_TLC_USED;
+    std::vector<uint16_t> lGolden(lHeaderOk ? lFrames * lChannels : 0);
+    if(lHeaderOk && fread(lGolden.data(), sizeof(uint16_t), lGolden.size(), lFile) != lGolden.size())
+    {
+        lHeaderOk = false;
+    }
+    fclose(lFile);
+
+    unsigned long lOurFrames = gCvFrames.size() / HOST_TLC_USED;
+    lResult.goldenFrames = lOurFrames;
+    lResult.golden = GOLDEN_MATCH;
+    lResult.firstMismatchMs = -1;
+    if(!lHeaderOk)
+    {
+        lResult.golden = GOLDEN_MISMATCH;
+        lResult.goldenMismatches = lOurFrames;
+        lResult.firstMismatchMs = 0;
+        return;
+    }
+    unsigned long lCommon = std::min<unsigned long>(lOurFrames, lFrames);
+    for(unsigned long lFrame = 0; lFrame < lCommon; lFrame++)
+    {
+        if(memcmp(&gCvFrames[lFrame * HOST_TLC_USED], &lGolden[lFrame * HOST_TLC_USED], HOST_TLC_USED * sizeof(uint16_t)) != 0)
+        {
+            if(lResult.firstMismatchMs < 0)
+            {
+                lResult.firstMismatchMs = (lFrame + 1) * HOST_LFO_TICK_US / 1000.0;
+            }
+            lResult.goldenMismatches++;
+        }
+    }
+    if(lOurFrames != lFrames)
+    {
+        if(lResult.firstMismatchMs < 0)
+        {
+            lResult.firstMismatchMs = (lCommon + 1) * HOST_LFO_TICK_US / 1000.0;
+        }
+        lResult.goldenMismatches += std::max<unsigned long>(lOurFrames, lFrames) - lCommon;
+    }
+    if(lResult.goldenMismatches)
+    {
+        lResult.golden = GOLDEN_MISMATCH;
+    }
+}
+
+static void runUntil(unsigned long lTimeUs)
+{
+    while(hostMicros() < lTimeUs)
+    {
+        hostRunLoop();
+    }
+}
+
+// runs in the forked child
+static void replay(const ReplayJob &lJob, const ReplayOptions &lOptions, ReplayResult &lResult)
+{
+    // an MPE zone needs the notes on their own channels
+    int lFileChannel = lJob.mode == POLY_MPE ? -1 : lOptions.channel;
+    std::vector<MidiEvent> lEvents;
+    std::string lError;
+    if(!loadMidiFile(lJob.path.c_str(), lFileChannel, lEvents, lError))
+    {
+        snprintf(lResult.error, sizeof(lResult.error), "%s", lError.c_str());
+        return;
+    }
+    std::vector<unsigned long> lTimes;
+    std::vector<uint8_t> lBytes;
+    scheduleMidiBytes(lEvents, lTimes, lBytes);
+
+    uint8_t lChannel = lFileChannel >= 0 ? lFileChannel : 0;
+    gHostLoopUs = lOptions.loopUs;
+    hostBegin();
+    hostSetMidiChannel(lChannel);
+    hostSetPolyphony(lJob.mode);
+    hostRunLoop();
+    gHostLfoTickCallback = captureCvFrame;
+
+    double lStart = cpuSeconds();
+    unsigned long lOffsetUs = hostMicros();
+    for(size_t i = 0; i < lBytes.size(); i++)
+    {
+        runUntil(lTimes[i] + lOffsetUs);
+        hostReceiveMidi(lBytes[i]);
+    }
+    lResult.seconds = cpuSeconds() - lStart;
+    lResult.peakQueueDepth = gHostStats.peakQueueDepth;
+    lResult.queueDrops = gHostStats.queueDrops;
+    lResult.rxOverruns = hostRxOverruns();
+    IdleReport lIdle = hostIdleReport();
+    unsigned long lIdleTicks = lIdle.activeTicks + lIdle.quiescentTicks;
+    lResult.idlePercent = lIdleTicks ? 100.0 * lIdle.quiescentTicks / lIdleTicks : 0.0;
+    lResult.wakes = lIdle.wakesMidi + lIdle.wakesPanel;
+    lResult.eepromStallUs = gHostStats.eepromStallUs;
+
+    // all notes off the long way round, the sketch doesn't know CC 123. on every channel the file used
+    uint16_t lUsedChannels = 1 << lChannel;
+    for(size_t i = 0; i < lBytes.size(); i++)
+    {
+        if(lBytes[i] >= 0x80 && lBytes[i] < 0xF0)
+        {
+            lUsedChannels |= 1 << (lBytes[i] & 0x0F);
+        }
+    }
+    std::vector<uint8_t> lOff;
+    for(uint8_t lOffChannel = 0; lOffChannel < 16; lOffChannel++)
+    {
+        if(!(lUsedChannels & (1 << lOffChannel)))
+        {
+            continue;
+        }
+        lOff.push_back(ALL_OFF_SUSTAIN_STATUS | lOffChannel);
+        lOff.push_back(ALL_OFF_SUSTAIN_CC);
+        lOff.push_back(0x00);
+        for(uint8_t lNote = 0; lNote < 128; lNote++)
+        {
+            lOff.push_back(ALL_OFF_NOTE_OFF_STATUS | lOffChannel);
+            lOff.push_back(lNote);
+            lOff.push_back(0x40);
+        }
+    }
+    // the sketch parses one byte per loop, so a solid burst of 387 bytes a channel would overflow gMidiBuffer.
+    // leave a few loops per message instead, these aren't part of the file being tested
+    unsigned long lTime = hostMicros();
+    for(size_t i = 0; i < lOff.size(); i++)
+    {
+        runUntil(lTime);
+        hostReceiveMidi(lOff[i]);
+        lTime += (i % 3 == 2) ? 4 * lOptions.loopUs : HOST_MIDI_BYTE_US;
+    }
+    runUntil(hostMicros() + lOptions.tailMs * 1000);
+
+    for(uint8_t lVoice = 0; lVoice < NUM_VOICES; lVoice++)
+    {
+        ADSR_STATUSES lState = hostVoiceState(lVoice);
+        if(lState == ATTACK_STATE || lState == DECAY_STATE || lState == SUSTAIN_STATE)
+        {
+            lResult.stuckVoices |= 1 << lVoice;
+        }
+    }
+    lResult.notesStillPressed = hostNotesPressed();
+    lResult.events = lEvents.size();
+    lResult.bytes = lBytes.size();
+    lResult.steals = gHostStats.steals;
+
+    if(!lOptions.goldenDir.empty())
+    {
+        std::string lPath = goldenPath(lOptions, lJob);
+        if(lOptions.updateGolden)
+        {
+            lResult.golden = writeGolden(lPath) ? GOLDEN_WRITTEN : GOLDEN_MISSING;
+        }
+        else
+        {
+            compareGolden(lPath, lResult);
+        }
+    }
+    lResult.ok = true;
+}
+
+static void addPath(const std::string &lPath, std::vector<std::string> &lFiles)
+{
+    struct stat lStat;
+    if(stat(lPath.c_str(), &lStat) != 0)
+    {
+        fprintf(stderr, "skipping %s: not found\n", lPath.c_str());
+        return;
+    }
+    if(!S_ISDIR(lStat.st_mode))
+    {
+        lFiles.push_back(lPath);
+        return;
+    }
+    DIR *lDir = opendir(lPath.c_str());
+    if(!lDir)
+    {
+        return;
+    }
+    std::vector<std::string> lEntries;
+    struct dirent *lEntry;
+    while((lEntry = readdir(lDir)) != NULL)
+    {
+        if(lEntry->d_name[0] != '.')
+        {
+            lEntries.push_back(lPath + "/" + lEntry->d_name);
+        }
+    }
+    closedir(lDir);
+    std::sort(lEntries.begin(), lEntries.end());
+    for(size_t i = 0; i < lEntries.size(); i++)
+    {
+        addPath(lEntries[i], lFiles);
+    }
+}
+
+static bool parseModes(const char *lList, std::vector<POLYPHONY> &lModes)
+{
+    lModes.clear();
+    std::string lAll(lList);
+    size_t lStart = 0;
+    while(true)
+    {
+        size_t lComma = lAll.find(',', lStart);
+        std::string lName = lAll.substr(lStart, lComma == std::string::npos ? std::string::npos : lComma - lStart);
+        bool lFound = false;
+        for(int m = 0; m < NUM_MODES; m++)
+        {
+            if(lName == gModeNames[m])
+            {
+                lModes.push_back(static_cast<POLYPHONY>(m));
+                lFound = true;
+            }
+        }
+        if(!lFound)
+        {
+            fprintf(stderr, "unknown mode %s\n", lName.c_str());
+            return false;
+        }
+        if(lComma == std::string::npos)
+        {
+            return true;
+        }
+        lStart = lComma + 1;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    ReplayOptions lOptions;
+    lOptions.updateGolden = false;
+    lOptions.loopUs = HOST_DEFAULT_LOOP_US;
+    lOptions.tailMs = 500;
+    lOptions.channel = 0;
+    long lJobs = sysconf(_SC_NPROCESSORS_ONLN);
+    std::vector<POLYPHONY> lModes;
+    for(int m = 0; m < NUM_MODES; m++)
+    {
+        lModes.push_back(static_cast<POLYPHONY>(m));
+    }
+
+    int lOpt;
+    while((lOpt = getopt(argc, argv, "j:g:ul:t:m:k")) != -1)
+    {
+        switch(lOpt)
+        {
+            case 'j': lJobs = atol(optarg); break;
+            case 'g': lOptions.goldenDir = optarg; break;
+            case 'u': lOptions.updateGolden = true; break;
+            case 'l': lOptions.loopUs = atol(optarg); break;
+            case 't': lOptions.tailMs = atol(optarg); break;
+            case 'm':
+                if(!parseModes(optarg, lModes))
+                {
+                    return 2;
+                }
+                break;
+            case 'k': lOptions.channel = -1; break;
+            default:
+                fprintf(stderr, "usage: %s [-j jobs] [-g golden dir] [-u] [-l loop us] [-t tail ms] [-m modes] [-k] files or directories...\n", argv[0]);
+                return 2;
+        }
+    }
+    lJobs = lJobs < 1 ? 1 : lJobs;
+
+    std::vector<std::string> lFiles;
+    for(int i = optind; i < argc; i++)
+    {
+        addPath(argv[i], lFiles);
+    }
+    if(lFiles.empty())
+    {
+        fprintf(stderr, "no MIDI files given\n");
+        return 2;
+    }
+
+    std::vector<ReplayJob> lJobList;
+    for(size_t f = 0; f < lFiles.size(); f++)
+    {
+        for(size_t m = 0; m < lModes.size(); m++)
+        {
+            ReplayJob lJob = {lFiles[f], lModes[m]};
+            lJobList.push_back(lJob);
+        }
+    }
+
+    // at most lJobs children at a time. each one writes its ReplayResult into its own pipe just before it exits,
+    // which is far smaller than a pipe buffer so the child never blocks on it
+    std::vector<ReplayResult> lResults(lJobList.size());
+    std::vector<pid_t> lPids(lJobList.size(), 0);
+    std::vector<int> lPipes(lJobList.size(), -1);
+    size_t lNext = 0;
+    long lRunning = 0;
+    fflush(stdout);
+    while(lNext < lJobList.size() || lRunning > 0)
+    {
+        while(lNext < lJobList.size() && lRunning < lJobs)
+        {
+            int lFds[2];
+            if(pipe(lFds) != 0)
+            {
+                perror("pipe");
+                return 2;
+            }
+            pid_t lPid = fork();
+            if(lPid < 0)
+            {
+                perror("fork");
+                return 2;
+            }
+            if(lPid == 0)
+            {
+                close(lFds[0]);
+                ReplayResult lResult;
+                memset(&lResult, 0, sizeof(lResult));
+                replay(lJobList[lNext], lOptions, lResult);
+                ssize_t lWritten = write(lFds[1], &lResult, sizeof(lResult));
+                _exit(lWritten == sizeof(lResult) ? 0 : 1);
+            }
+            close(lFds[1]);
+            lPids[lNext] = lPid;
+            lPipes[lNext] = lFds[0];
+            lNext++;
+            lRunning++;
+        }
+
+        pid_t lDone = wait(NULL);
+        for(size_t j = 0; j < lPids.size(); j++)
+        {
+            if(lPids[j] == lDone && lPipes[j] >= 0)
+            {
+                memset(&lResults[j], 0, sizeof(ReplayResult));
+                if(read(lPipes[j], &lResults[j], sizeof(ReplayResult)) != sizeof(ReplayResult))
+                {
+                    snprintf(lResults[j].error, sizeof(lResults[j].error), "run crashed");
+                }
+                close(lPipes[j]);
+                lPipes[j] = -1;
+                lRunning--;
+            }
+        }
+    }
+
+    bool lFailed = false;
+    unsigned long lTotalEvents = 0;
+    double lTotalSeconds = 0;
+    printf("%-32s %-7s %8s %10s %6s %6s %7s %12s %8s %-9s\n", "file", "mode", "events", "events/s", "queue", "drops", "steals",
+        "idle/wakes", "stuck", "golden");
+    for(size_t j = 0; j < lJobList.size(); j++)
+    {
+        const ReplayResult &lResult = lResults[j];
+        std::string lName = lJobList[j].path;
+        if(lName.size() > 32)
+        {
+            lName = "..." + lName.substr(lName.size() - 29);
+        }
+        if(!lResult.ok)
+        {
+            printf("%-32s %-7s error: %s\n", lName.c_str(), gModeNames[lJobList[j].mode], lResult.error);
+            lFailed = true;
+            continue;
+        }
+        char lStuck[16] = "-";
+        if(lResult.stuckVoices || lResult.notesStillPressed)
+        {
+            snprintf(lStuck, sizeof(lStuck), "v%02x n%u", lResult.stuckVoices, lResult.notesStillPressed);
+            lFailed = true;
+        }
+        if(lResult.golden == GOLDEN_MISMATCH)
+        {
+            lFailed = true;
+        }
+        char lIdle[16];
+        snprintf(lIdle, sizeof(lIdle), "%.0f%%/%lu", lResult.idlePercent, lResult.wakes);
+        printf("%-32s %-7s %8lu %10.0f %6d %6lu %7lu %12s %8s %-9s", lName.c_str(), gModeNames[lJobList[j].mode],
+            lResult.events, lResult.seconds > 0 ? lResult.events / lResult.seconds : 0.0, lResult.peakQueueDepth,
+            lResult.queueDrops + lResult.rxOverruns, lResult.steals, lIdle, lStuck, gGoldenNames[lResult.golden]);
+        if(lResult.golden == GOLDEN_MISMATCH)
+        {
+            printf(" %lu/%lu frames, first at %.1f ms", lResult.goldenMismatches, lResult.goldenFrames, lResult.firstMismatchMs);
+        }
+        if(lResult.eepromStallUs)
+        {
+            printf(" loop() waited %.1f ms on EEPROM", lResult.eepromStallUs / 1000.0);
+        }
+        printf("\n");
+        lTotalEvents += lResult.events;
+        lTotalSeconds += lResult.seconds;
+    }
+    printf("\n%zu runs, %ld jobs, %.0f events/s per core. stuck is the voice bitmask and the notes left in gNotesPressed\n",
+        lJobList.size(), lJobs, lTotalSeconds > 0 ? lTotalEvents / lTotalSeconds : 0.0);
+    return lFailed ? 1 : 0;
+}
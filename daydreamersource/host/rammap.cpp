@@ -0,0 +1,284 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/*
+ *  per object RAM map
+ *  reads the symbol table of the linked firmware and lists everything in .data, .bss and .noinit, biggest first,
+ *  so a change that grows RAM shows up before it runs the stack into the heap.
+ *  whatever is left of each section after the named objects (string literals in .data, padding) is listed as unnamed.
+ *  heap (Queue, std::vector) isn't in the ELF, SysEx 07 reads that off the running synth (see ramwatch.h).
+ *
+ *  build:  g++ -O2 -o rammap daydreamersource/host/rammap.cpp
+ *  run:    ./rammap [-r ram bytes] [-f min free bytes] [-j] daydreamersource.ino.elf
+ *          -r      SRAM size, default 2048 (ATmega328P)
+ *          -f      exit 1 if .data + .bss leaves less than this for heap and stack
+ *          -j      JSON, one object per line, for diffing two builds
+ *
+ *  the Arduino IDE leaves the ELF in its build folder. to get the map on every build add a hook to
+ *  platform.local.txt next to the core's platform.txt:
+ *      recipe.hooks.objcopy.postobjcopy.1.pattern=/path/to/rammap -f 600 "{build.path}/{build.project_name}.elf"
+ */
+
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <cxxabi.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define RAM_MAP_DEFAULT_RAM 2048
+
+typedef struct RamObject
+{
+    std::string name;
+    std::string section;
+    unsigned long address;
+    unsigned long size;
+} RamObject;
+
+typedef struct RamSection
+{
+    std::string name;
+    unsigned long size;
+    unsigned long named;        //bytes covered by symbols
+} RamSection;
+
+static bool biggestFirst(const RamObject &lA, const RamObject &lB)
+{
+    return lA.size != lB.size ? lA.size > lB.size : lA.name < lB.name;
+}
+
+static std::string demangle(const char *lName)
+{
+    int lStatus = 0;
+    char *lDemangled = abi::__cxa_demangle(lName, NULL, NULL, &lStatus);
+    if(lStatus != 0 || !lDemangled)
+    {
+        return lName;
+    }
+    std::string lResult(lDemangled);
+    free(lDemangled);
+    return lResult;
+}
+
+// the AVR ELF is 32 bit, the 64 bit case is only so the tool can be tried on a host binary
+template <typename Ehdr, typename Shdr, typename Sym, unsigned char (*SymType)(unsigned char)>
+static bool readRamObjects(const std::vector<uint8_t> &lFile, std::vector<RamSection> &lSections,
+    std::vector<RamObject> &lObjects, std::string &lError)
+{
+    const Ehdr *lHeader = reinterpret_cast<const Ehdr *>(&lFile[0]);
+    if(lFile.size() < sizeof(Ehdr) || lHeader->e_shoff == 0 ||
+        lHeader->e_shoff + (unsigned long)lHeader->e_shnum * sizeof(Shdr) > lFile.size() || lHeader->e_shstrndx >= lHeader->e_shnum)
+    {
+        lError = "no section headers";
+        return false;
+    }
+    const Shdr *lShdrs = reinterpret_cast<const Shdr *>(&lFile[lHeader->e_shoff]);
+    const char *lShNames = reinterpret_cast<const char *>(&lFile[lShdrs[lHeader->e_shstrndx].sh_offset]);
+
+    // RAM is whatever is allocated and writable
+    std::vector<int> lRamIndex(lHeader->e_shnum, -1);
+    const Shdr *lSymtab = NULL;
+    for(unsigned int i = 0; i < lHeader->e_shnum; i++)
+    {
+        const Shdr &lShdr = lShdrs[i];
+        if(lShdr.sh_type == SHT_SYMTAB)
+        {
+            lSymtab = &lShdr;
+        }
+        if((lShdr.sh_flags & SHF_ALLOC) && (lShdr.sh_flags & SHF_WRITE) && !(lShdr.sh_flags & SHF_EXECINSTR) && lShdr.sh_size)
+        {
+            RamSection lSection;
+            lSection.name = lShNames + lShdr.sh_name;
+            lSection.size = lShdr.sh_size;
+            lSection.named = 0;
+            lRamIndex[i] = lSections.size();
+            lSections.push_back(lSection);
+        }
+    }
+    if(!lSymtab || lSymtab->sh_link >= lHeader->e_shnum)
+    {
+        lError = "no symbol table, was it stripped?";
+        return false;
+    }
+
+    const Sym *lSyms = reinterpret_cast<const Sym *>(&lFile[lSymtab->sh_offset]);
+    const char *lNames = reinterpret_cast<const char *>(&lFile[lShdrs[lSymtab->sh_link].sh_offset]);
+    unsigned long lCount = lSymtab->sh_size / sizeof(Sym);
+    for(unsigned long i = 0; i < lCount; i++)
+    {
+        const Sym &lSym = lSyms[i];
+        if(SymType(lSym.st_info) != STT_OBJECT || lSym.st_size == 0 || lSym.st_shndx >= lHeader->e_shnum ||
+            lRamIndex[lSym.st_shndx] < 0)
+        {
+            continue;
+        }
+        RamSection &lSection = lSections[lRamIndex[lSym.st_shndx]];
+        RamObject lObject;
+        lObject.name = demangle(lNames + lSym.st_name);
+        lObject.section = lSection.name;
+        lObject.address = lSym.st_value;
+        lObject.size = lSym.st_size;
+        lSection.named += lSym.st_size;
+        lObjects.push_back(lObject);
+    }
+    return true;
+}
+
+static unsigned char elf32SymType(unsigned char lInfo)
+{
+    return ELF32_ST_TYPE(lInfo);
+}
+
+static unsigned char elf64SymType(unsigned char lInfo)
+{
+    return ELF64_ST_TYPE(lInfo);
+}
+
+static bool loadFile(const char *lPath, std::vector<uint8_t> &lFile)
+{
+    FILE *lIn = fopen(lPath, "rb");
+    if(!lIn)
+    {
+        return false;
+    }
+    uint8_t lBlock[4096];
+    size_t lRead;
+    while((lRead = fread(lBlock, 1, sizeof(lBlock), lIn)) > 0)
+    {
+        lFile.insert(lFile.end(), lBlock, lBlock + lRead);
+    }
+    fclose(lIn);
+    return true;
+}
+
+static void jsonString(const std::string &lText)
+{
+    putchar('"');
+    for(size_t i = 0; i < lText.size(); i++)
+    {
+        if(lText[i] == '"' || lText[i] == '\\')
+        {
+            putchar('\\');
+        }
+        putchar(lText[i]);
+    }
+    putchar('"');
+}
+
+static void usage(const char *lName)
+{
+    fprintf(stderr, "usage: %s [-r ram bytes] [-f min free bytes] [-j] firmware.elf\n", lName);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long lRam = RAM_MAP_DEFAULT_RAM;
+    long lMinFree = -1;
+    bool lJson = false;
+
+    int lOpt;
+    while((lOpt = getopt(argc, argv, "r:f:j")) != -1)
+    {
+        switch(lOpt)
+        {
+            case 'r': lRam = atol(optarg); break;
+            case 'f': lMinFree = atol(optarg); break;
+            case 'j': lJson = true; break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if(argc - optind != 1)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<uint8_t> lFile;
+    if(!loadFile(argv[optind], lFile) || lFile.size() < EI_NIDENT || memcmp(&lFile[0], ELFMAG, SELFMAG) != 0)
+    {
+        fprintf(stderr, "%s: not an ELF file\n", argv[optind]);
+        return 1;
+    }
+    if(lFile[EI_DATA] != ELFDATA2LSB)
+    {
+        fprintf(stderr, "%s: only little endian ELF\n", argv[optind]);
+        return 1;
+    }
+
+    std::vector<RamSection> lSections;
+    std::vector<RamObject> lObjects;
+    std::string lError;
+    bool lOk = lFile[EI_CLASS] == ELFCLASS32 ?
+        readRamObjects<Elf32_Ehdr, Elf32_Shdr, Elf32_Sym, elf32SymType>(lFile, lSections, lObjects, lError) :
+        readRamObjects<Elf64_Ehdr, Elf64_Shdr, Elf64_Sym, elf64SymType>(lFile, lSections, lObjects, lError);
+    if(!lOk)
+    {
+        fprintf(stderr, "%s: %s\n", argv[optind], lError.c_str());
+        return 1;
+    }
+    std::sort(lObjects.begin(), lObjects.end(), biggestFirst);
+
+    unsigned long lStatic = 0;
+    for(size_t i = 0; i < lSections.size(); i++)
+    {
+        lStatic += lSections[i].size;
+    }
+    long lLeft = (long)lRam - (long)lStatic;
+
+    if(lJson)
+    {
+        for(size_t i = 0; i < lObjects.size(); i++)
+        {
+            printf("{\"name\": ");
+            jsonString(lObjects[i].name);
+            printf(", \"section\": \"%s\", \"size\": %lu}\n", lObjects[i].section.c_str(), lObjects[i].size);
+        }
+        for(size_t i = 0; i < lSections.size(); i++)
+        {
+            printf("{\"section\": \"%s\", \"size\": %lu, \"unnamed\": %lu}\n", lSections[i].name.c_str(),
+                lSections[i].size, lSections[i].size - lSections[i].named);
+        }
+        printf("{\"static\": %lu, \"ram\": %lu, \"left\": %ld}\n", lStatic, lRam, lLeft);
+    }
+    else
+    {
+        printf("%6s  %-8s  %-10s  %s\n", "bytes", "section", "address", "object");
+        for(size_t i = 0; i < lObjects.size(); i++)
+        {
+            printf("%6lu  %-8s  0x%08lx  %s\n", lObjects[i].size, lObjects[i].section.c_str(), lObjects[i].address,
+                lObjects[i].name.c_str());
+        }
+        printf("\n");
+        for(size_t i = 0; i < lSections.size(); i++)
+        {
+            printf("%-8s %6lu bytes, %lu of them unnamed\n", lSections[i].name.c_str(), lSections[i].size,
+                lSections[i].size - lSections[i].named);
+        }
+        printf("static RAM %lu of %lu bytes, %ld left for heap and stack\n", lStatic, lRam, lLeft);
+    }
+
+    if(lMinFree >= 0 && lLeft < lMinFree)
+    {
+        fprintf(stderr, "%s: only %ld bytes left for heap and stack, want %ld\n", argv[optind], lLeft, lMinFree);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,285 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it
+*   under the terms of the GNU General Public License as published by the Free Software Foundation,
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/*
+ *  offline renderer
+ *  plays a MIDI file through the host build of the sketch and feeds the TLC outputs after every loop()
+ *  into analogmodel.h, then writes 16 bit mono WAV at MODEL_SAMPLE_RATE.
+ *  good for hearing what a firmware change did without the board, or for diffing two renders.
+ *
+ *  build:  g++ -O2 -mavx -std=gnu++11 -DHOST_BUILD -Idaydreamersource/host/arduino -Idaydreamersource -o render \
+ *              daydreamersource/host/render.cpp daydreamersource/host/analogmodel.cpp daydreamersource/host/hostsketch.cpp \
+ *              daydreamersource/host/midifile.cpp daydreamersource/[a-z]*.cpp
+ *          (leave out -mavx on machines without it, the model falls back to SSE)
+ *  run:    ./render [-m mode] [-l loop us] [-t tail ms] [-k] [-K knob=value ...] in.mid out.wav
+ *          -m      POLYPHONY mode, e.g. POLY_3. default MONO_1. POLY_MPE keeps the file's channels like -k,
+ *                  with channel 1 as the manager of a zone over the other 15
+ *          -K      knob position 0 - 1023: attack, decay, sustain, release, glide, lfofreq, lfovcf, lfovco
+ *          -k      keep the file's MIDI channels instead of moving everything onto channel 1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "hostsketch.h"
+#include "midifile.h"
+#include "analogmodel.h"
+
+#define NUM_MODES 8
+#define RENDER_BLOCK_SAMPLES 4096   //written to the file in blocks this big
+
+const char *gModeNames[NUM_MODES] = {"MONO_1", "MONO_2", "MONO_3", "MONO_6", "POLY_1", "POLY_2", "POLY_3", "POLY_MPE"};
+
+class WavWriter
+{
+public:
+    WavWriter()
+    {
+        mFile = NULL;
+        mSamples = 0;
+        mClipped = 0;
+        mPeak = 0;
+    }
+
+    bool open(const char *lPath)
+    {
+        mFile = fopen(lPath, "wb");
+        if(mFile)
+        {
+            writeHeader();
+        }
+        return mFile != NULL;
+    }
+
+    void write(const float *lSamples, unsigned int lCount)
+    {
+        int16_t lBlock[RENDER_BLOCK_SAMPLES];
+        while(lCount)
+        {
+            unsigned int lChunk = lCount < RENDER_BLOCK_SAMPLES ? lCount : RENDER_BLOCK_SAMPLES;
+            for(unsigned int i = 0; i < lChunk; i++)
+            {
+                float lSample = lSamples[i];
+                mPeak = fabsf(lSample) > mPeak ? fabsf(lSample) : mPeak;
+                if(lSample > 1.0f || lSample < -1.0f)
+                {
+                    mClipped++;
+                    lSample = lSample > 1.0f ? 1.0f : -1.0f;
+                }
+                int16_t lValue = static_cast<int16_t>(lrintf(lSample * 32767.0f));
+                // WAV is little endian whatever the host is
+                uint8_t *lBytes = reinterpret_cast<uint8_t *>(&lBlock[i]);
+                lBytes[0] = lValue & 0xFF;
+                lBytes[1] = (lValue >> 8) & 0xFF;
+            }
+            fwrite(lBlock, sizeof(int16_t), lChunk, mFile);
+            mSamples += lChunk;
+            lSamples += lChunk;
+            lCount -= lChunk;
+        }
+    }
+
+    void close()
+    {
+        // go back and fill in the sizes
+        fseek(mFile, 0, SEEK_SET);
+        writeHeader();
+        fclose(mFile);
+        mFile = NULL;
+    }
+
+    unsigned long mSamples;
+    unsigned long mClipped;
+    float mPeak;
+
+private:
+    void put(uint32_t lValue, int lBytes)
+    {
+        for(int i = 0; i < lBytes; i++)
+        {
+            fputc((lValue >> (8 * i)) & 0xFF, mFile);
+        }
+    }
+
+    void writeHeader()
+    {
+        uint32_t lDataBytes = mSamples * 2;
+        fwrite("RIFF", 1, 4, mFile);
+        put(36 + lDataBytes, 4);
+        fwrite("WAVEfmt ", 1, 8, mFile);
+        put(16, 4);                         //fmt chunk size
+        put(1, 2);                          //PCM
+        put(1, 2);                          //mono
+        put(MODEL_SAMPLE_RATE, 4);
+        put(MODEL_SAMPLE_RATE * 2, 4);      //bytes per second
+        put(2, 2);                          //bytes per frame
+        put(16, 2);                         //bits
+        fwrite("data", 1, 4, mFile);
+        put(lDataBytes, 4);
+    }
+
+    FILE *mFile;
+};
+
+static AnalogModel gModel;
+static WavWriter gWav;
+static unsigned long gSamplesRendered = 0;
+static float gBlock[RENDER_BLOCK_SAMPLES];
+
+static double cpuSeconds()
+{
+    struct timespec lNow;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &lNow);
+    return lNow.tv_sec + lNow.tv_nsec / 1e9;
+}
+
+// one loop() of the sketch, then render the samples that cover it from the CV it left on the TLC
+static void renderLoop()
+{
+    hostRunLoop();
+    uint16_t lCv[HOST_TLC_USED];
+    for(uint8_t lChannel = 0; lChannel < HOST_TLC_USED; lChannel++)
+    {
+        lCv[lChannel] = hostTlcOutput(lChannel);
+    }
+    unsigned long lDue = (unsigned long)((unsigned long long)hostMicros() * MODEL_SAMPLE_RATE / 1000000);
+    while(gSamplesRendered < lDue)
+    {
+        unsigned int lCount = lDue - gSamplesRendered < RENDER_BLOCK_SAMPLES ? lDue - gSamplesRendered : RENDER_BLOCK_SAMPLES;
+        gModel.render(lCv, gBlock, lCount);
+        gWav.write(gBlock, lCount);
+        gSamplesRendered += lCount;
+    }
+}
+
+static void runUntil(unsigned long lTimeUs)
+{
+    while(hostMicros() < lTimeUs)
+    {
+        renderLoop();
+    }
+}
+
+static void usage(const char *lName)
+{
+    fprintf(stderr, "usage: %s [-m mode] [-l loop us] [-t tail ms] [-k] [-K knob=value ...] in.mid out.wav\n", lName);
+}
+
+int main(int argc, char **argv)
+{
+    POLYPHONY lMode = MONO_1;
+    unsigned long lLoopUs = HOST_DEFAULT_LOOP_US;
+    unsigned long lTailMs = 2000;
+    int lChannel = 0;
+    std::vector<std::pair<int, int> > lKnobs;
+
+    int lOpt;
+    while((lOpt = getopt(argc, argv, "m:l:t:kK:")) != -1)
+    {
+        switch(lOpt)
+        {
+            case 'm':
+            {
+                int m = 0;
+                while(m < NUM_MODES && strcmp(optarg, gModeNames[m]) != 0)
+                {
+                    m++;
+                }
+                if(m == NUM_MODES)
+                {
+                    fprintf(stderr, "unknown mode %s\n", optarg);
+                    return 2;
+                }
+                lMode = static_cast<POLYPHONY>(m);
+                break;
+            }
+            case 'l': lLoopUs = atol(optarg); break;
+            case 't': lTailMs = atol(optarg); break;
+            case 'k': lChannel = -1; break;
+            case 'K':
+            {
+                std::string lSetting(optarg);
+                size_t lEquals = lSetting.find('=');
+                int lKnob = lEquals == std::string::npos ? -1 : hostKnobChannel(lSetting.substr(0, lEquals).c_str());
+                if(lKnob < 0)
+                {
+                    fprintf(stderr, "unknown knob setting %s\n", optarg);
+                    return 2;
+                }
+                lKnobs.push_back(std::make_pair(lKnob, atoi(lSetting.c_str() + lEquals + 1)));
+                break;
+            }
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if(argc - optind != 2)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if(lMode == POLY_MPE)
+    {
+        lChannel = -1;
+    }
+    std::vector<MidiEvent> lEvents;
+    std::string lError;
+    if(!loadMidiFile(argv[optind], lChannel, lEvents, lError))
+    {
+        fprintf(stderr, "%s: %s\n", argv[optind], lError.c_str());
+        return 1;
+    }
+    std::vector<unsigned long> lTimes;
+    std::vector<uint8_t> lBytes;
+    scheduleMidiBytes(lEvents, lTimes, lBytes);
+
+    if(!gWav.open(argv[optind + 1]))
+    {
+        fprintf(stderr, "can't write %s\n", argv[optind + 1]);
+        return 1;
+    }
+
+    gHostLoopUs = lLoopUs;
+    hostBegin();
+    for(size_t i = 0; i < lKnobs.size(); i++)
+    {
+        hostSetKnob(lKnobs[i].first, lKnobs[i].second);
+    }
+    hostSetMidiChannel(lChannel >= 0 ? lChannel : 0);
+    hostSetPolyphony(lMode);
+
+    double lStart = cpuSeconds();
+    for(size_t i = 0; i < lBytes.size(); i++)
+    {
+        runUntil(lTimes[i]);
+        hostReceiveMidi(lBytes[i]);
+    }
+    runUntil(hostMicros() + lTailMs * 1000);
+    double lSeconds = cpuSeconds() - lStart;
+    gWav.close();
+
+    double lSongSeconds = gWav.mSamples / (double)MODEL_SAMPLE_RATE;
+    printf("%s: %s, %lu events, %.1f s of audio in %.2f s (%.0fx realtime)\n", argv[optind + 1], gModeNames[lMode],
+        (unsigned long)lEvents.size(), lSongSeconds, lSeconds, lSeconds > 0 ? lSongSeconds / lSeconds : 0.0);
+    printf("peak %.1f dBFS, %lu samples clipped, %lu steals\n", 20 * log10(gWav.mPeak + 1e-9), gWav.mClipped, gHostStats.steals);
+    return 0;
+}
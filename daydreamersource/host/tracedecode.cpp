@@ -0,0 +1,165 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/*
+ *  trace decoder
+ *  turns a capture of traceFlush() dumps (see trace.h) into a readable timeline of
+ *  note ons/offs, voice assignment, steals and envelope state changes.
+ *
+ *  capture the TX pin to a file, for example with serialport.bat > capture.bin, then
+ *  build:  g++ -O2 -o tracedecode daydreamersource/host/tracedecode.cpp
+ *  run:    ./tracedecode capture.bin       (or pipe the capture into stdin)
+ *
+ *  anything between dumps is skipped, so stray Serial output in the capture is fine.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+#define TRACE_DECODER
+#include "../typedefs.h"
+#include "../trace.h"
+
+#define TICK_MS 4.096       //TIMER0: 16 MHz / 256 prescaler / 256 counts
+#define SUBTICK_MS 0.016    //one TCNT0 count
+
+const char *gEnvNames[] = {"attack", "decay", "sustain", "release", "off"};
+const char *gPolyNames[] = {"MONO_1", "MONO_2", "MONO_3", "MONO_6", "POLY_1", "POLY_2", "POLY_3", "POLY_MPE"};
+
+struct Totals
+{
+    unsigned long noteOns;
+    unsigned long noteOffs;
+    unsigned long assigns;
+    unsigned long steals;
+    unsigned long frees;
+    unsigned long lost;
+};
+
+const char *nameOrQuestion(const char **lNames, unsigned lCount, unsigned lIndex)
+{
+    return lIndex < lCount ? lNames[lIndex] : "?";
+}
+
+void printRecord(const TraceRecord &lRecord, double lMs, Totals &lTotals)
+{
+    printf("%12.3f ms  ", lMs);
+    switch(lRecord.event)
+    {
+        case TRACE_NOTE_ON:
+            printf("note on      %3u vel %u\n", lRecord.arg1, lRecord.arg2);
+            lTotals.noteOns++;
+            break;
+        case TRACE_NOTE_OFF:
+            printf("note off     %3u\n", lRecord.arg1);
+            lTotals.noteOffs++;
+            break;
+        case TRACE_VOICE_ASSIGN:
+            printf("assign       slot %u <- %u\n", lRecord.arg1, lRecord.arg2);
+            lTotals.assigns++;
+            break;
+        case TRACE_VOICE_STEAL:
+            printf("steal        slot %u, was %u\n", lRecord.arg1, lRecord.arg2);
+            lTotals.steals++;
+            break;
+        case TRACE_VOICE_FREE:
+            printf("free         slot %u (%u)\n", lRecord.arg1, lRecord.arg2);
+            lTotals.frees++;
+            break;
+        case TRACE_ENV_STATE:
+            printf("envelope     voice %u %s\n", lRecord.arg1, nameOrQuestion(gEnvNames, 5, lRecord.arg2));
+            break;
+        case TRACE_SUSTAIN:
+            printf("sustain      %s\n", lRecord.arg1 ? "on" : "off");
+            break;
+        case TRACE_POLYPHONY:
+            printf("polyphony    %s\n", nameOrQuestion(gPolyNames, 8, lRecord.arg1));
+            break;
+        default:
+            printf("event %u     %u %u\n", lRecord.event, lRecord.arg1, lRecord.arg2);
+            break;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    FILE *lIn = argc > 1 ? fopen(argv[1], "rb") : stdin;
+    if(!lIn)
+    {
+        fprintf(stderr, "can't open %s\n", argv[1]);
+        return 1;
+    }
+
+    std::vector<uint8_t> lBytes;
+    int c;
+    while((c = fgetc(lIn)) != EOF)
+    {
+        lBytes.push_back(static_cast<uint8_t>(c));
+    }
+
+    Totals lTotals = {0, 0, 0, 0, 0, 0};
+    unsigned long lWraps = 0;
+    int lLastTick = -1;
+    unsigned lDumps = 0;
+
+    for(size_t i = 0; i + 4 <= lBytes.size(); i++)
+    {
+        if(lBytes[i] != 'D' || lBytes[i + 1] != 'T')
+        {
+            continue;
+        }
+        unsigned lCount = lBytes[i + 2];
+        unsigned lLost = lBytes[i + 3];
+        if(lCount > TRACE_BUFFER_LENGTH || i + 4 + lCount * 6 > lBytes.size())
+        {
+            continue;
+        }
+
+        lDumps++;
+        printf("---- dump %u: %u records", lDumps, lCount);
+        if(lLost)
+        {
+            printf(", %u older records lost", lLost);
+        }
+        printf("\n");
+        lTotals.lost += lLost;
+
+        const uint8_t *lData = &lBytes[i + 4];
+        for(unsigned r = 0; r < lCount; r++, lData += 6)
+        {
+            TraceRecord lRecord;
+            lRecord.tick = lData[0] | (lData[1] << 8);
+            lRecord.subTick = lData[2];
+            lRecord.event = lData[3];
+            lRecord.arg1 = lData[4];
+            lRecord.arg2 = lData[5];
+
+            // records are in order, so a smaller tick means the 16 bit counter wrapped
+            if(lLastTick >= 0 && lRecord.tick < lLastTick)
+            {
+                lWraps++;
+            }
+            lLastTick = lRecord.tick;
+            double lMs = ((double)lWraps * 65536 + lRecord.tick) * TICK_MS + lRecord.subTick * SUBTICK_MS;
+            printRecord(lRecord, lMs, lTotals);
+        }
+        i += 3 + lCount * 6;
+    }
+
+    printf("---- %u dumps: %lu note ons, %lu note offs, %lu assigns, %lu steals, %lu frees, %lu records lost\n",
+        lDumps, lTotals.noteOns, lTotals.noteOffs, lTotals.assigns, lTotals.steals, lTotals.frees, lTotals.lost);
+    return 0;
+}
@@ -0,0 +1,193 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "idlemonitor.h"
+#include <HardwareSerial.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+IdleMonitor::IdleMonitor()
+{
+    mTick = 0;
+    mTickStamp = 0;
+    mWakeStart = 0;
+    mWaking = false;
+    mState = IDLE_ACTIVE;
+    mLastTick = 0;
+    mStillTicks = 0;
+    mLastCheckTick = 0;
+    for(uint8_t lParam = 0; lParam < NUM_PARAMS; lParam++)
+    {
+        mKnobSnapshot[lParam] = 0;
+    }
+    mReport.activeTicks = 0;
+    mReport.quiescentTicks = 0;
+    mReport.wakesMidi = 0;
+    mReport.wakesPanel = 0;
+    mReport.lastWakeUs = 0;
+    mReport.maxWakeUs = 0;
+}
+
+IdleMonitor::~IdleMonitor(){}
+
+// from the TIMER0 interrupt
+void IdleMonitor::tick()
+{
+    mTick++;
+    if(mState == IDLE_QUIESCENT)
+    {
+        mTickStamp = (mTick << 8) | TCNT0;
+    }
+}
+
+uint16_t IdleMonitor::ticks()
+{
+    uint8_t lOldSreg = SREG;
+    cli();
+    uint16_t lTick = mTick;
+    SREG = lOldSreg;
+    return lTick;
+}
+
+// low byte of the tick and TCNT0, in TCNT0 counts. read together with interrupts off. a compare match that
+// landed while they were off has already cleared TCNT0 but isn't in mTick yet
+uint16_t IdleMonitor::stamp()
+{
+    uint8_t lOldSreg = SREG;
+    cli();
+    uint8_t lCount = TCNT0;
+    uint16_t lTick = mTick;
+    if((TIFR0 & (1 << OCF0A)) && lCount < OCR0A)
+    {
+        lTick++;
+    }
+    SREG = lOldSreg;
+    return (lTick << 8) | lCount;
+}
+
+uint16_t IdleMonitor::tickStamp()
+{
+    uint8_t lOldSreg = SREG;
+    cli();
+    uint16_t lStamp = mTickStamp;
+    SREG = lOldSreg;
+    return lStamp;
+}
+
+// adds the ticks since the last call to whichever state we are in
+void IdleMonitor::countTime()
+{
+    uint16_t lNow = ticks();
+    uint16_t lElapsed = lNow - mLastTick;
+    mLastTick = lNow;
+    if(mState == IDLE_QUIESCENT)
+    {
+        mReport.quiescentTicks += lElapsed;
+    }
+    else
+    {
+        mReport.activeTicks += lElapsed;
+        mStillTicks = (mStillTicks > 0xFFFF - lElapsed) ? 0xFFFF : mStillTicks + lElapsed;
+    }
+}
+
+// compares against the last snapshot and moves the snapshot along when something changed
+bool IdleMonitor::knobsMoved(const int *lKnobs)
+{
+    bool lMoved = false;
+    for(uint8_t lParam = 0; lParam < NUM_PARAMS; lParam++)
+    {
+        int lChange = lKnobs[lParam] - mKnobSnapshot[lParam];
+        if(lChange > IDLE_KNOB_THRESHOLD || lChange < -IDLE_KNOB_THRESHOLD)
+        {
+            mKnobSnapshot[lParam] = lKnobs[lParam];
+            lMoved = true;
+        }
+    }
+    return lMoved;
+}
+
+// once per loop while ACTIVE. returns true when it has just gone QUIESCENT
+bool IdleMonitor::updateActive(bool lCanRest, const int *lKnobs)
+{
+    countTime();
+    if(knobsMoved(lKnobs) || !lCanRest)
+    {
+        mStillTicks = 0;
+        return false;
+    }
+    if(mStillTicks < IDLE_ENTER_TICKS)
+    {
+        return false;
+    }
+    mState = IDLE_QUIESCENT;
+    mLastCheckTick = mLastTick;
+    return true;
+}
+
+// while QUIESCENT: time to look at the knobs again
+bool IdleMonitor::checkDue()
+{
+    countTime();
+    if(static_cast<uint16_t>(mLastTick - mLastCheckTick) < IDLE_CHECK_TICKS)
+    {
+        return false;
+    }
+    mLastCheckTick = mLastTick;
+    return true;
+}
+
+// lWokeAt is the stamp() of the interrupt that ended the sleep. the time is taken in resumed()
+void IdleMonitor::wake(IDLE_WAKE_REASONS lReason, uint16_t lWokeAt)
+{
+    countTime();
+    mState = IDLE_ACTIVE;
+    mStillTicks = 0;
+    if(lReason == IDLE_WAKE_MIDI)
+    {
+        mReport.wakesMidi++;
+    }
+    else
+    {
+        mReport.wakesPanel++;
+    }
+    mWakeStart = lWokeAt;
+    mWaking = true;
+}
+
+// from loop() just before doMidiStates(). only the first one after a wake counts
+void IdleMonitor::resumed()
+{
+    if(!mWaking)
+    {
+        return;
+    }
+    mWaking = false;
+    uint32_t lUs = static_cast<uint32_t>(static_cast<uint16_t>(stamp() - mWakeStart)) * IDLE_US_PER_COUNT;
+    mReport.lastWakeUs = lUs > 0xFFFF ? 0xFFFF : lUs;
+    mReport.maxWakeUs = mReport.lastWakeUs > mReport.maxWakeUs ? mReport.lastWakeUs : mReport.maxWakeUs;
+}
+
+void IdleMonitor::sendReport()
+{
+    const uint8_t *lBytes = reinterpret_cast<const uint8_t *>(&mReport);
+    Serial.write('D');
+    Serial.write('I');
+    // the AVR is little endian, so the struct goes out as it is
+    for(uint8_t i = 0; i < sizeof(mReport); i++)
+    {
+        Serial.write(lBytes[i]);
+    }
+}
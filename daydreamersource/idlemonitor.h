@@ -0,0 +1,88 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/* IdleMonitor Class
+ *
+ * Works out when the synth can go quiet, and keeps count of how long it spends each way.
+ *
+ * ACTIVE -> QUIESCENT once every envelope is OFF, no MIDI is waiting and no knob has moved for IDLE_ENTER_TICKS.
+ * While QUIESCENT the sketch sleeps in idle mode (the UART and timers keep running) and skips the rest of loop(),
+ * and the TIMER0 interrupt skips the LFO. Every interrupt wakes the CPU and one of two things brings the synth back:
+ * - a MIDI byte. the USART RX interrupt wakes it and loop() carries straight on, well inside one byte time (320 us)
+ * - a knob that moved more than IDLE_KNOB_THRESHOLD. the knobs are only read every IDLE_CHECK_TICKS
+ *
+ * Time is counted in TIMER0 ticks (4.096 ms) from the interrupt. A wake is timed in TCNT0 counts (16 us),
+ * from the interrupt that ended the sleep to the first doMidiStates() after it:
+ * - a panel wake starts at the TIMER0 interrupt that made the knob check due, stamped in tick()
+ * - a MIDI wake starts where the USART RX interrupt returns to after sleep_cpu(). that interrupt belongs to
+ *   HardwareSerial, so its own few us aren't counted
+ * the stamps carry the low byte of the tick, so anything up to a second is measured right.
+ *
+ * SysEx 05 (see midiutils.h) asks for a report. it goes out on the UART like the trace dump:
+ *   'D' 'I' then IdleReport, little endian
+*/
+
+#include <stdint.h>
+#include "typedefs.h"
+
+#ifndef IDLEMONITOR_H
+#define IDLEMONITOR_H
+
+#define IDLE_ENTER_TICKS 244        //~1 s of nothing happening
+#define IDLE_CHECK_TICKS 12         //~50 ms between knob checks while quiescent
+#define IDLE_KNOB_THRESHOLD 8       //ADC counts, above the noise on the knob mux
+#define IDLE_US_PER_COUNT 16        //TCNT0 runs at 16 MHz / 256
+
+typedef struct IdleReport
+{
+    uint32_t activeTicks;
+    uint32_t quiescentTicks;
+    uint16_t wakesMidi;
+    uint16_t wakesPanel;
+    uint16_t lastWakeUs;
+    uint16_t maxWakeUs;
+} IdleReport;
+
+class IdleMonitor
+{
+    public:
+    IdleMonitor();
+    ~IdleMonitor();
+
+    volatile uint16_t mTick;    //counted in the TIMER0 interrupt
+    volatile uint16_t mTickStamp;   //stamp() of the last TIMER0 interrupt while QUIESCENT
+    uint16_t mWakeStart;
+    bool mWaking;               //woken, but loop() hasn't got back to doMidiStates() yet
+    IDLE_STATES mState;
+    uint16_t mLastTick;
+    uint16_t mStillTicks;       //how long everything has been quiet while ACTIVE
+    uint16_t mLastCheckTick;
+    int mKnobSnapshot[NUM_PARAMS];
+    IdleReport mReport;
+
+    void tick();
+    uint16_t ticks();
+    uint16_t stamp();
+    uint16_t tickStamp();
+    void countTime();
+    bool knobsMoved(const int *lKnobs);
+    bool updateActive(bool lCanRest, const int *lKnobs);
+    bool checkDue();
+    void wake(IDLE_WAKE_REASONS lReason, uint16_t lWokeAt);
+    void resumed();
+    void sendReport();
+};
+
+#endif // IDLEMONITOR_H
@@ -15,80 +15,149 @@
 
 #include "lfogenerator.h"
 #include <HardwareSerial.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 #include <math.h>
 
+// one full sine cycle, -127 to 127, indexed by the top 8 bits of the phase
+const PROGMEM int8_t gLfoSineTable[256] = {
+       0,    3,    6,    9,   12,   16,   19,   22,   25,   28,   31,   34,   37,   40,   43,   46,
+      49,   51,   54,   57,   60,   63,   65,   68,   71,   73,   76,   78,   81,   83,   85,   88,
+      90,   92,   94,   96,   98,  100,  102,  104,  106,  107,  109,  111,  112,  113,  115,  116,
+     117,  118,  120,  121,  122,  122,  123,  124,  125,  125,  126,  126,  126,  127,  127,  127,
+     127,  127,  127,  127,  126,  126,  126,  125,  125,  124,  123,  122,  122,  121,  120,  118,
+     117,  116,  115,  113,  112,  111,  109,  107,  106,  104,  102,  100,   98,   96,   94,   92,
+      90,   88,   85,   83,   81,   78,   76,   73,   71,   68,   65,   63,   60,   57,   54,   51,
+      49,   46,   43,   40,   37,   34,   31,   28,   25,   22,   19,   16,   12,    9,    6,    3,
+       0,   -3,   -6,   -9,  -12,  -16,  -19,  -22,  -25,  -28,  -31,  -34,  -37,  -40,  -43,  -46,
+     -49,  -51,  -54,  -57,  -60,  -63,  -65,  -68,  -71,  -73,  -76,  -78,  -81,  -83,  -85,  -88,
+     -90,  -92,  -94,  -96,  -98, -100, -102, -104, -106, -107, -109, -111, -112, -113, -115, -116,
+    -117, -118, -120, -121, -122, -122, -123, -124, -125, -125, -126, -126, -126, -127, -127, -127,
+    -127, -127, -127, -127, -126, -126, -126, -125, -125, -124, -123, -122, -122, -121, -120, -118,
+    -117, -116, -115, -113, -112, -111, -109, -107, -106, -104, -102, -100,  -98,  -96,  -94,  -92,
+     -90,  -88,  -85,  -83,  -81,  -78,  -76,  -73,  -71,  -68,  -65,  -63,  -60,  -57,  -54,  -51,
+     -49,  -46,  -43,  -40,  -37,  -34,  -31,  -28,  -25,  -22,  -19,  -16,  -12,   -9,   -6,   -3
+};
+
 LfoGenerator::LfoGenerator()
 {
-    mLfoVcoScalar = 0;
-    mLfoVcfScalar = 0;
     mLfoRecordLength = 0;
+    mWave = 0;
 
-    mLfoVcfScalarOutput = 0;
-    mLfoVcoScalarOutput = 0;
+    mSineOrSquare = true;
+    mPhase = 0;
+    mPhaseIncrement = 0;
+    mVoicePhaseSpread = 0;
+    mKeySync = LFO_KEY_SYNC;
+    for(uint8_t lVoice = 0; lVoice < LFO_NUM_VOICES; lVoice++)
+    {
+        mVoicePhaseOffset[lVoice] = 0;
+        mVoiceWave[lVoice] = 0;
+    }
+    setVoicePhaseSpread(LFO_VOICE_PHASE_SPREAD);
 }
 
 LfoGenerator::~LfoGenerator(){}
 
-void LfoGenerator::setLfoVcfScalar(int lReading)
-{
-    mLfoVcfScalar = static_cast<double>(lReading) / 1023;
-}
-
-void LfoGenerator::setLfoVcoScalar(int lReading)
+void LfoGenerator::setSineOrSquare(bool lSineOrSquare)
 {
-    mLfoVcoScalar = static_cast<double>(lReading) / 1023;
+    mSineOrSquare = lSineOrSquare;
 }
 
 void LfoGenerator::setLfoRecordLength(int lReading)
 {
     // Analog read max is 1023. lReading is between 0 and 1023,, so that manes this  can be length 8 (knob up) to 1031 (knob down)
-    mLfoRecordLength = ((1023 - lReading) + 8);
+    double lRecordLength = ((1023 - lReading) + 8);
+    if(lRecordLength == mLfoRecordLength)
+    {
+        return;
+    }
+    mLfoRecordLength = lRecordLength;
+    // one turn every mLfoRecordLength + 1 ticks, same period as the old tNum counter
+    unsigned int lIncrement = 65536UL / (static_cast<unsigned long>(lRecordLength) + 1);
+    // the interrupt reads this, don't let it see half a write
+    uint8_t lOldSreg = SREG;
+    cli();
+    mPhaseIncrement = lIncrement;
+    SREG = lOldSreg;
 }
 
-void LfoGenerator::calculateModulation(bool lSineOrSquare)
+void LfoGenerator::setVoicePhaseSpread(unsigned int lSpread)
 {
-    static double tNum = 0;
-    if(tNum < mLfoRecordLength)
-    // if time is less than the set record, increment
+    mVoicePhaseSpread = lSpread;
+    if(mKeySync)
     {
-        tNum++;
+        // key synced voices pick up the new spread on their next note on
+        return;
     }
-    else
+    // the interrupt reads the offsets
+    uint8_t lOldSreg = SREG;
+    cli();
+    for(uint8_t lVoice = 0; lVoice < LFO_NUM_VOICES; lVoice++)
     {
-    //reset time to 0
-        tNum = 0;
+        mVoicePhaseOffset[lVoice] = lSpread * lVoice;
     }
-    double t = tNum/mLfoRecordLength;
-    //turn the time into a percentage
-    
-    // t goes between 0 and 1.0
-    // so basically the LFO speed knob turns up the speed of time passing through a periodic function
+    SREG = lOldSreg;
+}
 
-    if(lSineOrSquare)
+void LfoGenerator::setKeySync(bool lKeySync)
+{
+    if(lKeySync == mKeySync)
     {
-        mLfoVcfScalarOutput = mLfoVcfScalar * calculateSine(t);
-        mLfoVcoScalarOutput = mLfoVcoScalar * calculateSine(t);
+        return;
     }
-    else
+    mKeySync = lKeySync;
+    setVoicePhaseSpread(mVoicePhaseSpread);
+}
+
+void LfoGenerator::syncVoice(uint8_t lVoice)
+{
+    // wrap around is intended. mPhase + offset lands on voice * spread right now
+    if(mKeySync)
     {
-        mLfoVcfScalarOutput = mLfoVcfScalar * calculateSquare(t);
-        mLfoVcoScalarOutput = mLfoVcoScalar * calculateSquare(t);
+        uint8_t lOldSreg = SREG;
+        cli();
+        mVoicePhaseOffset[lVoice] = mVoicePhaseSpread * lVoice - mPhase;
+        SREG = lOldSreg;
     }
 }
 
-double LfoGenerator::calculateSine(double lt_sine)
+int8_t LfoGenerator::calculateWave(uint16_t lPhase)
 {
-    return sin(2 * 3.14 * lt_sine);
+    if(mSineOrSquare)
+    {
+        return pgm_read_byte_near(gLfoSineTable + (lPhase >> 8));
+    }
+    else
+    {
+        // first half of the cycle is high, same as the old t <= 0.5
+        return (lPhase & 0x8000) ? -127 : 127;
+    }
 }
-double LfoGenerator::calculateSquare(double lt_square)
+
+void LfoGenerator::calculateModulation()
 {
-    if (lt_square <= 0.5)
+    // so basically the LFO speed knob turns up the speed of time passing through a periodic function
+    mPhase += mPhaseIncrement;
+
+    mWave = calculateWave(mPhase);
+
+    for(uint8_t lVoice = 0; lVoice < LFO_NUM_VOICES; lVoice++)
     {
-        return 1.0;
+        mVoiceWave[lVoice] = calculateWave(mPhase + mVoicePhaseOffset[lVoice]);
     }
-    else
+}
+
+LfoBank::LfoBank(){}
+
+LfoBank::~LfoBank(){}
+
+void LfoBank::calculateModulation()
+{
+    for(uint8_t lLfo = 0; lLfo < LFO_BANK_SIZE; lLfo++)
     {
-        return -1.0;
+        mLfos[lLfo].calculateModulation();
     }
 }
 
@@ -16,16 +16,37 @@
 /*
  *  LfoGenerator class
  *  This class can be used for each LFO
- *  For this project I will only have one LfoGenerator Object.
+ *  Each LfoGenerator keeps its own phase, so there can be more than one. They live in an LfoBank.
  *  
- *  update the knob values of the gLfoAmtPot and lfoFreqPot
- *  this will give you the next scalar (-1 to 1) of LFO
+ *  update the knob value of the lfoFreqPot
+ *  this will give you the next value (-127 to 127) of LFO. how far it moves anything is up to modmatrix.h
  *  Calculation should happen within a timer interrupt.
  *  getting potentiometer values should happen outside of timer interrupts
  *  
  *  I this project, I am using a ~60Hz timer on TIMER0. I will change recordlength accordingly to this samplerate
+ *
+ *  Phase is a 16 bit accumulator, one full turn is 65536. The waveform comes out of a 256 entry sine table
+ *  so there are no trig calls in the interrupt.
+ *  Every voice reads the same accumulator plus its own phase offset:
+ *  - free run: offsets are voice * mVoicePhaseSpread, so stacked voices wobble out of step
+ *  - key sync: syncVoice() moves that voice's offset so it starts at voice * mVoicePhaseSpread on its note on.
+ *    with no spread that is phase 0: the sine's upward zero crossing, so the pitch doesn't jump, or the start
+ *    of the square's high half
+ *  Both are set over MIDI with CONTROL_LFO_PHASE_SPREAD and CONTROL_LFO_KEY_SYNC (see midiutils.h).
 */
 
+#ifndef LFOGENERATOR_H
+#define LFOGENERATOR_H
+
+#include <stdint.h>
+#include "typedefs.h"
+
+#define LFO_NUM_VOICES NUM_VOICES
+#define LFO_BANK_SIZE 1         // raise this to add more LFOs. each one costs a phase add and LFO_NUM_VOICES table reads per tick
+#define LFO_VOICE_PHASE_SPREAD 0        // 0 to 65535. 0 keeps every voice in step, CONTROL_LFO_PHASE_SPREAD 7F is 1/6 of a turn
+#define LFO_PHASE_SPREAD_PER_STEP 86    // per CONTROL_LFO_PHASE_SPREAD step, so 127 is the even spread
+#define LFO_KEY_SYNC false
+
 class LfoGenerator
 {
     public:
@@ -33,19 +54,39 @@ class LfoGenerator
     LfoGenerator();
     ~LfoGenerator();
 
-    double mLfoVcfScalar;
-    double mLfoVcoScalar;
     double mLfoRecordLength;
+    int8_t mWave;               //-127 to 127 at the shared phase, for the things that aren't a voice
 
-    double mLfoVcfScalarOutput; //-1 to 1 value output which is calculated
-    double mLfoVcoScalarOutput;
+    // phase state
+    bool mSineOrSquare;
+    uint16_t mPhase;
+    uint16_t mPhaseIncrement;
+    uint16_t mVoicePhaseSpread;
+    bool mKeySync;
+    uint16_t mVoicePhaseOffset[LFO_NUM_VOICES];
+    int8_t mVoiceWave[LFO_NUM_VOICES];  //-127 to 127 per voice, unscaled by depth
 
-    void calculateModulation(bool lSineOrSquare);
-    double calculateSine(double lt_sine);
-    double calculateSquare(double lt_square);
+    void calculateModulation();
+    int8_t calculateWave(uint16_t lPhase);
+    void setSineOrSquare(bool lSineOrSquare);
     void setLfoRecordLength(int lReading);
-    void setLfoVcfScalar(int lReading);
-    void setLfoVcoScalar(int lReading);
+    void setVoicePhaseSpread(unsigned int lSpread);
+    void setKeySync(bool lKeySync);
+    void syncVoice(uint8_t lVoice);
+};
+
+// all the LFOs, advanced together from the timer interrupt
+class LfoBank
+{
+    public:
+    LfoBank();
+    ~LfoBank();
+
+    LfoGenerator mLfos[LFO_BANK_SIZE];
+
+    void calculateModulation();
 };
 
-int calculateLogFromLinear(int lLinearValue);
\ No newline at end of file
+int calculateLogFromLinear(int lLinearValue);
+
+#endif // LFOGENERATOR_H
\ No newline at end of file
@@ -27,29 +27,67 @@ Status:
     Note off:   0x8n
     pitch bend: 0xEn
     control message: 0xBn
+    program change: 0xCn (one data byte)
+    channel pressure: 0xDn (one data byte, only used by MPE)
+    system exclusive: 0xF0 ... 0xF7 (no channel)
 
     channel number (n) (0-F (15)
+    only gMidiChannelNumber is listened to, plus the member channels when an MPE zone is set up (see mpezone.h)
 
 Data1:
     pitch bend MSB (0 - 7F)
     
     control message:
         modulation (01)
+        data entry MSB (06)
         sustain pedal (40)
+        RPN LSB (64), RPN MSB (65)
+            RPN 0,0 is pitch bend range. the data entry after it is the range in semitones
+            RPN 0,6 is the MPE configuration message. the data entry after it is the number of member channels
+        NRPN LSB (62), NRPN MSB (63)
+            we have no NRPNs. selecting one deselects the RPN, so the data entry after it is ignored
+        timbre (4A), MPE member channels only
+        unison spread (5E), detunes the oscillators stacked on one note in MONO_2 - 6 and POLY_2 - 3
+        LFO phase spread (5F), how far apart each voice's LFO runs (see lfogenerator.h)
+        LFO key sync (50), restarts a voice's LFO on its note on
+        any other number can be mapped to a sound parameter, see parametersources.h
+
+    program change:
+        preset slot to recall, 7F hands every parameter back to the panel
 
     Note Numbers:
         0 (C)
         78 (highest C)
         3C (middle C)
 
+System exclusive:
+    F0 7D <command> <payload ...> F7
+    7D is the non-commercial manufacturer ID. anything else is ignored.
+    payload bytes are handed to handleSysexData() as they arrive so nothing has to be buffered,
+    then handleSysexEnd() gets called from doMidiStates() once the message is finished (or broken off).
+    commands:
+        01  pitch calibration upload: <voice> <one 7 bit signed delta per gTlcValues entry>
+        02  trace dump request, no payload (only with TRACE_ENABLED, see trace.h)
+        03  map a CC to a parameter: <parameter> <cc number, 7F to unmap>
+            01, 06, 40, 4A, 50, 5E, 5F, 62, 63, 64 and 65 are taken by the firmware and leave the mapping as it was
+        04  save the current parameter values as a preset: <slot>
+        05  idle report request, no payload (see idlemonitor.h)
+        06  set a mod matrix route: <route> <source> <destination> <depth, 40 is none> (see modmatrix.h)
+        07  RAM report request, no payload (see ramwatch.h)
+        08  TLC dot correction trim: <channel> <trim 0 - 3F> (see dotcorrection.h)
+
 Data2:
     pitch bend LSB (0 - 7F)
     control message:
         modulation (0 - 7F)
         sustain pedal (0 or 7F)
+        unison spread (0 - 7F, 7F is half a semitone each way)
+        LFO phase spread (0 - 7F, starts at 0 with every voice in step, 7F spreads the six voices evenly)
+        LFO key sync (0 - 3F off, 40 - 7F on)
     Velocity:
         1 - 7F for newNote on
         40 for newNote off
+        a newNote on with velocity 0 is treated as a newNote off
 */
 
 #include <stdint.h>
@@ -57,6 +95,7 @@ Data2:
 #include "queue.h"
 #include "typedefs.h"
 #include "multiplexer.h"
+#include "mpezone.h"
 
 #ifndef MIDIUTILS_H
 #define MIDIUTILS_H
@@ -66,29 +105,79 @@ Data2:
 #define STATUS_NOTE_OFF 0x80
 #define STATUS_PITCH    0xE0
 #define STATUS_CONTROL  0xB0
+#define STATUS_PROGRAM  0xC0
+#define STATUS_PRESSURE 0xD0
+//system messages, these have no channel
+#define STATUS_SYSEX        0xF0
+#define STATUS_SYSEX_END    0xF7
+#define STATUS_REALTIME     0xF8    //0xF8 and above can show up anywhere, even inside a sysex
+//sysex
+#define SYSEX_MANUFACTURER_ID       0x7D
+#define SYSEX_PITCH_CALIBRATION     0x01
+#define SYSEX_TRACE_DUMP            0x02
+#define SYSEX_PARAMETER_CC          0x03
+#define SYSEX_PRESET_SAVE           0x04
+#define SYSEX_IDLE_REPORT           0x05
+#define SYSEX_MOD_ROUTE             0x06
+#define SYSEX_RAM_REPORT            0x07
+#define SYSEX_DOT_CORRECTION        0x08
 //control messages
 #define CONTROL_MOD     0x01
+#define CONTROL_DATA    0x06
 #define CONTROL_SUS     0x40
+#define CONTROL_TIMBRE  0x4A
+#define CONTROL_UNISON_SPREAD 0x5E
+#define CONTROL_LFO_PHASE_SPREAD 0x5F
+#define CONTROL_LFO_KEY_SYNC 0x50
+#define CONTROL_NRPN_LSB 0x62
+#define CONTROL_NRPN_MSB 0x63
+#define CONTROL_RPN_LSB 0x64
+#define CONTROL_RPN_MSB 0x65
+//RPNs
+#define RPN_NULL        0x7F
+#define RPN_PITCH_BEND_RANGE 0x00
+#define RPN_MPE_CONFIGURATION 0x06
 
 Queue gMidiBuffer(60);   //bigger is not better! 3 bytes per message. this handles 20 messages
 
 uint8_t gMidiChannelNumber = 0;
+MpeZone gMpe;
 
 struct
 {
     PARSE_STATUSES parseStatus;
     STATUSES status;
+    uint8_t channel;
     //data1
     uint8_t newNote;
     uint8_t pitchBendMSB;
     CONTROL_STATUSES controlStatus;
+    uint8_t controlNumber;
+    uint8_t program;
+    uint8_t pressure;
 
     //data2
     uint8_t velocity;
     uint8_t pitchBendLSB;
     uint8_t modulation;
     bool sustainIsOn;
-} gMidiState = {STATUS, UNDEFINED_STATUS, 0x3C, 0x00, UNDEFINED_CONTROL, 1, 0x00, 0, false};
+    uint8_t rpnMSB;
+    uint8_t rpnLSB;
+    uint8_t dataEntry;
+    uint8_t controlValue;
+
+    //sysex
+    uint8_t sysexCommand;
+    uint8_t sysexLength;    //number of data bytes after F0, including the manufacturer ID and command
+    bool sysexIsOurs;
+    bool sysexIsComplete;   //false if a status byte broke the message off before F7
+
+    uint8_t runningStatus;  //last channel status byte, even one for another channel. 0 when there isn't one
+} gMidiState = {STATUS, UNDEFINED_STATUS, 0, 0x3C, 0x00, UNDEFINED_CONTROL, 0, 0, 0, 1, 0x00, 0, false, RPN_NULL, RPN_NULL, 0, 0, 0, 0, false, false, 0};
+
+// defined in the sketch. lIndex counts payload bytes from 0, after the manufacturer ID and command
+void handleSysexData(uint8_t lCommand, uint8_t lIndex, uint8_t lByte);
+void handleSysexEnd(uint8_t lCommand, uint8_t lPayloadLength, bool lIsComplete);
 
 /********************************************************************************************************
 checkMidi
@@ -107,118 +196,325 @@ void checkMidi()
     while (Serial.available() > 1); //when at least 3 bytes available (one message)   
 }
 
+/********************************************************************************************************
+getSysexByte()
+one byte of a system exclusive message. payload bytes go straight to handleSysexData()
+********************************************************************************************************/
+void getSysexByte(uint8_t lMidibyte)
+{
+    if(lMidibyte >= STATUS_REALTIME)
+    {
+        return;
+    }
+    if(lMidibyte & 0x80)
+    {
+        // F7 ends it properly. any other status byte breaks it off, and that status byte is lost
+        gMidiState.sysexIsComplete = (lMidibyte == STATUS_SYSEX_END);
+        gMidiState.parseStatus = gMidiState.sysexIsOurs ? DONE : STATUS;
+        return;
+    }
+
+    if(gMidiState.sysexLength == 0)
+    {
+        gMidiState.sysexIsOurs = (lMidibyte == SYSEX_MANUFACTURER_ID);
+    }
+    else if(gMidiState.sysexLength == 1)
+    {
+        gMidiState.sysexCommand = lMidibyte;
+    }
+    else if(gMidiState.sysexIsOurs)
+    {
+        handleSysexData(gMidiState.sysexCommand, gMidiState.sysexLength - 2, lMidibyte);
+    }
+    if(gMidiState.sysexLength < 0xFF)
+    {
+        gMidiState.sysexLength++;
+    }
+}
+
+/********************************************************************************************************
+absorbMpeExpression()
+bend, pressure and timbre from an MPE member channel only ever change that channel's entry in gMpe,
+so they are finished here and never get as far as doMidiStates(). returns true if it took the message
+********************************************************************************************************/
+bool absorbMpeExpression()
+{
+    if(!gMpe.isMember(gMidiState.channel))
+    {
+        return false;
+    }
+    switch(gMidiState.status)
+    {
+        case PITCH_BEND:
+            gMpe.setBend(gMidiState.channel, gMidiState.pitchBendLSB, gMidiState.pitchBendMSB);
+            return true;
+        case CHANNEL_PRESSURE:
+            gMpe.setPressure(gMidiState.channel, gMidiState.pressure);
+            return true;
+        case CONTROL:
+            if(gMidiState.controlNumber == CONTROL_TIMBRE)
+            {
+                gMpe.setTimbre(gMidiState.channel, gMidiState.controlValue);
+                return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+/********************************************************************************************************
+parseStatusByte()
+a channel status byte, either straight from gMidiBuffer or repeated for running status.
+leaves parseStatus at DATA1 if the message is for us
+********************************************************************************************************/
+void parseStatusByte(uint8_t lMidibyte)
+{
+    gMidiState.runningStatus = lMidibyte;
+
+    //check that we are on the right midi channel
+    gMidiState.channel = lMidibyte & 15;
+    if(gMidiState.channel != gMidiChannelNumber && !gMpe.isMember(gMidiState.channel))
+    {
+        return;
+    }
+
+    // get status
+    switch(lMidibyte>>4)
+    {
+        case (STATUS_NOTE_ON>>4):
+            gMidiState.status = NOTE_ON;
+            gMidiState.parseStatus = DATA1;
+            break;
+        case (STATUS_NOTE_OFF>>4):
+            gMidiState.status = NOTE_OFF;
+            gMidiState.parseStatus = DATA1;
+            break;
+        case (STATUS_PITCH>>4):
+            gMidiState.status = PITCH_BEND;
+            gMidiState.parseStatus = DATA1;
+            break;
+        case (STATUS_CONTROL>>4):
+            gMidiState.status = CONTROL;
+            gMidiState.parseStatus = DATA1;
+            break;
+        case (STATUS_PROGRAM>>4):
+            gMidiState.status = PROGRAM_CHANGE;
+            gMidiState.parseStatus = DATA1;
+            break;
+        case (STATUS_PRESSURE>>4):
+            gMidiState.status = CHANNEL_PRESSURE;
+            gMidiState.parseStatus = DATA1;
+            break;
+        default:
+            gMidiState.status = UNDEFINED_STATUS;
+            gMidiState.parseStatus = STATUS;
+            break;
+    }
+}
+
+/********************************************************************************************************
+parseMidiByte()
+one byte of gMidiBuffer into gMidiState
+********************************************************************************************************/
+void parseMidiByte(uint8_t lMidibyte)
+{
+    // realtime bytes can show up anywhere, even in the middle of a message. none of them mean anything to us
+    if(lMidibyte >= STATUS_REALTIME)
+    {
+        return;
+    }
+    // a status byte where data was expected breaks the unfinished message off
+    if((lMidibyte & 0x80) && (gMidiState.parseStatus == DATA1 || gMidiState.parseStatus == DATA2))
+    {
+        gMidiState.parseStatus = STATUS;
+    }
+
+    switch(gMidiState.parseStatus)
+    {
+        case STATUS:
+            if(lMidibyte == STATUS_SYSEX)
+            {
+                gMidiState.status = SYSTEM_EXCLUSIVE;
+                gMidiState.parseStatus = SYSEX;
+                gMidiState.runningStatus = 0;
+                gMidiState.sysexCommand = 0;
+                gMidiState.sysexLength = 0;
+                gMidiState.sysexIsOurs = false;
+                gMidiState.sysexIsComplete = false;
+                break;
+            }
+            // the other system common messages cancel running status, and we don't use any of them
+            if(lMidibyte >= STATUS_SYSEX)
+            {
+                gMidiState.runningStatus = 0;
+                break;
+            }
+            if(lMidibyte & 0x80)
+            {
+                parseStatusByte(lMidibyte);
+                break;
+            }
+
+            // running status. a data byte here is data1 of another message with the last status.
+            // data bytes of a message for some other channel stay here and get dropped one at a time
+            if(gMidiState.runningStatus == 0)
+            {
+                break;
+            }
+            parseStatusByte(gMidiState.runningStatus);
+            if(gMidiState.parseStatus != DATA1)
+            {
+                break;
+            }
+            //fall through
+        
+        // get data1
+        case DATA1:
+            switch(gMidiState.status)
+            {
+                case NOTE_ON:
+                case NOTE_OFF:
+                    gMidiState.newNote = lMidibyte;
+                    break;
+                case PITCH_BEND:
+                    gMidiState.pitchBendLSB = lMidibyte;
+                    break;
+                case CONTROL:
+                    gMidiState.controlNumber = lMidibyte;
+                    switch(lMidibyte)
+                    {
+                        case CONTROL_MOD:
+                            gMidiState.controlStatus = MODULATION;
+                            break;
+                        case CONTROL_SUS:
+                            gMidiState.controlStatus = SUSTAIN_PEDAL;
+                            break;
+                        case CONTROL_RPN_MSB:
+                            gMidiState.controlStatus = RPN_MSB;
+                            break;
+                        case CONTROL_RPN_LSB:
+                            gMidiState.controlStatus = RPN_LSB;
+                            break;
+                        case CONTROL_NRPN_MSB:
+                        case CONTROL_NRPN_LSB:
+                            gMidiState.controlStatus = NRPN_SELECT;
+                            break;
+                        case CONTROL_DATA:
+                            gMidiState.controlStatus = DATA_ENTRY;
+                            break;
+                        default:
+                            gMidiState.controlStatus = UNDEFINED_CONTROL;
+                            break;
+                    }
+                    // member channels only get to send RPNs. mod wheel and sustain belong to the manager channel
+                    if(gMidiState.channel != gMidiChannelNumber &&
+                        (gMidiState.controlStatus == MODULATION || gMidiState.controlStatus == SUSTAIN_PEDAL))
+                    {
+                        gMidiState.controlStatus = UNDEFINED_CONTROL;
+                    }
+                    break;
+                case PROGRAM_CHANGE:
+                    gMidiState.program = lMidibyte;
+                    break;
+                case CHANNEL_PRESSURE:
+                    gMidiState.pressure = lMidibyte;
+                    break;
+                default:
+                    break;
+            }
+            //program change and channel pressure only have the one data byte
+            if(gMidiState.status == PROGRAM_CHANGE || gMidiState.status == CHANNEL_PRESSURE)
+            {
+                gMidiState.parseStatus = absorbMpeExpression() ? STATUS : DONE;
+            }
+            else
+            {
+                gMidiState.parseStatus = DATA2;
+            }
+            break;
+
+        // sysex bytes come in bursts, so take everything that's buffered instead of one byte per loop
+        case SYSEX:
+            getSysexByte(lMidibyte);
+            while(gMidiState.parseStatus == SYSEX && !gMidiBuffer.isEmpty())
+            {
+                getSysexByte(gMidiBuffer.pop());
+            }
+            break;
+
+        //get data2
+        case DATA2:
+            switch(gMidiState.status)
+            {
+                case NOTE_ON:
+                    // a note on with velocity 0 is a note off. plenty of keyboards and most files send them
+                    if(lMidibyte == 0)
+                    {
+                        gMidiState.status = NOTE_OFF;
+                    }
+                    else
+                    {
+                        gMidiState.velocity = lMidibyte;
+                    }
+                    break;
+                case PITCH_BEND:
+                    gMidiState.pitchBendMSB = lMidibyte;
+                    break;
+                case CONTROL:
+                    gMidiState.controlValue = lMidibyte;
+                    switch(gMidiState.controlStatus)
+                    {
+                        case SUSTAIN_PEDAL:
+                            gMidiState.sustainIsOn = (lMidibyte > 0x3F);
+                            break;
+                        case MODULATION:
+                            gMidiState.modulation = lMidibyte;
+                            break;
+                        case RPN_MSB:
+                            gMidiState.rpnMSB = lMidibyte;
+                            break;
+                        case RPN_LSB:
+                            gMidiState.rpnLSB = lMidibyte;
+                            break;
+                        case NRPN_SELECT:
+                            gMidiState.rpnMSB = RPN_NULL;
+                            gMidiState.rpnLSB = RPN_NULL;
+                            break;
+                        case DATA_ENTRY:
+                            gMidiState.dataEntry = lMidibyte;
+                            break;
+                        default:
+                            break;
+                    }
+                case NOTE_OFF:
+                default:
+                    break;
+            }
+            gMidiState.parseStatus = absorbMpeExpression() ? STATUS : DONE;
+            break;
+
+        default:
+            break;
+    }
+}
+
 /********************************************************************************************************
 getMidiStates()
 reads gMidiBuffer
 turns them into information stored in gMidiState.
+one byte per loop, or up to MPE_PARSE_BYTES_PER_LOOP with an MPE zone. member channel expression never
+reaches doMidiStates(), so it keeps going through that until a message is DONE
 ********************************************************************************************************/
 void getMidiStates()
 {
     // Serial.println(gMidiBuffer.size(), DEC);  // good for seeing parsing latency
     // delay(300);
-    if(!gMidiBuffer.isEmpty())
+    uint8_t lBudget = gMpe.isEnabled() ? MPE_PARSE_BYTES_PER_LOOP : 1;
+    while(lBudget && !gMidiBuffer.isEmpty() && gMidiState.parseStatus != DONE)
     {
-        uint8_t lMidibyte = gMidiBuffer.pop();
-        // Serial.println(lMidibyte, HEX);
-        
-        switch(gMidiState.parseStatus)
-        {
-            case STATUS:
-                //check that we are on the right midi channel
-                if(static_cast<uint8_t>(lMidibyte & 15) != gMidiChannelNumber)
-                {
-                    return;
-                }
-
-                // get status
-                switch(lMidibyte>>4)
-                {
-                    case (STATUS_NOTE_ON>>4):
-                        gMidiState.status = NOTE_ON;
-                        gMidiState.parseStatus = DATA1;
-                        break;
-                    case (STATUS_NOTE_OFF>>4):
-                        gMidiState.status = NOTE_OFF;
-                        gMidiState.parseStatus = DATA1;
-                        break;
-                    case (STATUS_PITCH>>4):
-                        gMidiState.status = PITCH_BEND;
-                        gMidiState.parseStatus = DATA1;
-                        break;
-                    case (STATUS_CONTROL>>4):
-                        gMidiState.status = CONTROL;
-                        gMidiState.parseStatus = DATA1;
-                        break;
-                    default:
-                        gMidiState.status = UNDEFINED_STATUS;
-                        gMidiState.parseStatus = STATUS;
-                        break;
-                }
-                break;
-            
-            // get data1
-            case DATA1:
-                switch(gMidiState.status)
-                {
-                    case NOTE_ON:
-                    case NOTE_OFF:
-                        gMidiState.newNote = lMidibyte;
-                        break;
-                    case PITCH_BEND:
-                        gMidiState.pitchBendLSB = lMidibyte;
-                        break;
-                    case CONTROL:
-                        switch(lMidibyte)
-                        {
-                            case CONTROL_MOD:
-                                gMidiState.controlStatus = MODULATION;
-                                break;
-                            case CONTROL_SUS:
-                                gMidiState.controlStatus = SUSTAIN_PEDAL;
-                                break;
-                            default:
-                                gMidiState.controlStatus = UNDEFINED_CONTROL;
-                                break;
-                        }
-                        break;
-                    default:
-                        break;
-                }
-                gMidiState.parseStatus = DATA2;
-                break;
-
-            //get data2
-            case DATA2:
-                switch(gMidiState.status)
-                {
-                    case NOTE_ON:
-                        gMidiState.velocity = lMidibyte;
-                        break;
-                    case PITCH_BEND:
-                        gMidiState.pitchBendMSB = lMidibyte;
-                        break;
-                    case CONTROL:
-                        switch(gMidiState.controlStatus)
-                        {
-                            case SUSTAIN_PEDAL:
-                                gMidiState.sustainIsOn = (lMidibyte > 0x3F);
-                                break;
-                            case MODULATION:
-                                gMidiState.modulation = lMidibyte;
-                                break;
-                            default:
-                                break;
-                        }
-                    case NOTE_OFF:
-                    default:
-                        break;
-                }
-                gMidiState.parseStatus = DONE;
-                break;
-
-            default:
-                break;
-        }
+        parseMidiByte(gMidiBuffer.pop());
+        lBudget--;
     }
 }
 
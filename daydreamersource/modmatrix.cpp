@@ -0,0 +1,169 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "modmatrix.h"
+
+ModMatrix::ModMatrix()
+{
+    for(uint8_t lRoute = 0; lRoute < MOD_ROUTES; lRoute++)
+    {
+        mRoutes[lRoute].source = MOD_SRC_LFO;
+        mRoutes[lRoute].destination = MOD_DST_PITCH;
+        mRoutes[lRoute].depth = 0;
+    }
+    mRoutes[MOD_ROUTE_PANEL_VCF].destination = MOD_DST_LPF;
+    mRoutes[MOD_ROUTE_PANEL_FREQ].source = MOD_SRC_WHEEL;
+    mRoutes[MOD_ROUTE_PANEL_FREQ].destination = MOD_DST_LFO_RATE;
+    mRoutes[MOD_ROUTE_MPE_PRESSURE].source = MOD_SRC_PRESSURE;
+    mRoutes[MOD_ROUTE_MPE_PRESSURE].destination = MOD_DST_VCA;
+
+    for(uint8_t lColumn = 0; lColumn < MOD_COLUMNS; lColumn++)
+    {
+        for(uint8_t lSource = 0; lSource < NUM_MOD_SOURCES; lSource++)
+        {
+            mSource[lSource][lColumn] = 0;
+        }
+        for(uint8_t lDestination = 0; lDestination < NUM_MOD_DESTINATIONS; lDestination++)
+        {
+            mOutput[lDestination][lColumn] = 0;
+        }
+    }
+    for(uint8_t i = 0; i < sizeof(mSysexArgs); i++)
+    {
+        mSysexArgs[i] = 0;
+    }
+    compile();
+}
+
+ModMatrix::~ModMatrix(){}
+
+// the flat list of routes that do something, and which destinations each source reaches through them
+void ModMatrix::compile()
+{
+    mActiveCount = 0;
+    for(uint8_t lSource = 0; lSource < NUM_MOD_SOURCES; lSource++)
+    {
+        mSourceDestinations[lSource] = 0;
+    }
+    for(uint8_t lRoute = 0; lRoute < MOD_ROUTES; lRoute++)
+    {
+        if(mRoutes[lRoute].depth != 0)
+        {
+            mActive[mActiveCount++] = lRoute;
+            mSourceDestinations[mRoutes[lRoute].source] |= (1 << mRoutes[lRoute].destination);
+        }
+    }
+    // a route that went away has to be taken back off its destination too
+    mDirty = (1 << NUM_MOD_DESTINATIONS) - 1;
+}
+
+void ModMatrix::setRoute(uint8_t lRoute, MOD_SOURCES lSource, MOD_DESTINATIONS lDestination, int8_t lDepth)
+{
+    mRoutes[lRoute].source = lSource;
+    mRoutes[lRoute].destination = lDestination;
+    mRoutes[lRoute].depth = lDepth;
+    compile();
+}
+
+// the panel calls this every loop, so only recompile when it actually changed
+void ModMatrix::setDepth(uint8_t lRoute, int8_t lDepth)
+{
+    if(mRoutes[lRoute].depth != lDepth)
+    {
+        mRoutes[lRoute].depth = lDepth;
+        compile();
+    }
+}
+
+void ModMatrix::setSource(MOD_SOURCES lSource, uint8_t lColumn, int lValue)
+{
+    if(mSource[lSource][lColumn] != lValue)
+    {
+        mSource[lSource][lColumn] = lValue;
+        mDirty |= mSourceDestinations[lSource];
+    }
+}
+
+void ModMatrix::update()
+{
+    if(!mDirty)
+    {
+        return;
+    }
+    for(uint8_t lDestination = 0; lDestination < NUM_MOD_DESTINATIONS; lDestination++)
+    {
+        if(mDirty & (1 << lDestination))
+        {
+            for(uint8_t lColumn = 0; lColumn < MOD_COLUMNS; lColumn++)
+            {
+                mOutput[lDestination][lColumn] = 0;
+            }
+        }
+    }
+
+    for(uint8_t i = 0; i < mActiveCount; i++)
+    {
+        const ModRoute &lRoute = mRoutes[mActive[i]];
+        if(!(mDirty & (1 << lRoute.destination)))
+        {
+            continue;
+        }
+        bool lPerVoice = (MOD_VOICE_DESTINATIONS >> lRoute.destination) & 1;
+        bool lUnipolar = ((MOD_UNIPOLAR_DESTINATIONS >> lRoute.destination) & 1) && ((MOD_BIPOLAR_SOURCES >> lRoute.source) & 1);
+        bool lGlobalSource = (MOD_GLOBAL_SOURCES >> lRoute.source) & 1;
+        uint8_t lFirst = lPerVoice ? 0 : MOD_GLOBAL;
+        uint8_t lLast = lPerVoice ? NUM_VOICES - 1 : MOD_GLOBAL;
+        for(uint8_t lColumn = lFirst; lColumn <= lLast; lColumn++)
+        {
+            int lValue = mSource[lRoute.source][lGlobalSource ? MOD_GLOBAL : lColumn];
+            lValue = lUnipolar ? (lValue + 127) >> 1 : lValue;
+            mOutput[lRoute.destination][lColumn] += (lValue * lRoute.depth) >> 7;
+        }
+    }
+    mDirty = 0;
+}
+
+int ModMatrix::output(MOD_DESTINATIONS lDestination, uint8_t lColumn)
+{
+    return mOutput[lDestination][lColumn];
+}
+
+unsigned int ModMatrix::applyLevel(MOD_DESTINATIONS lDestination, uint8_t lColumn, unsigned int lCv)
+{
+    long lLevel = lCv + ((static_cast<long>(lCv) * mOutput[lDestination][lColumn]) >> 7);
+    lLevel = lLevel < 0 ? 0 : lLevel;
+    return lLevel > MOD_TLC_MAX ? MOD_TLC_MAX : lLevel;
+}
+
+void ModMatrix::sysexByte(uint8_t lIndex, uint8_t lByte)
+{
+    if(lIndex < sizeof(mSysexArgs))
+    {
+        mSysexArgs[lIndex] = lByte;
+    }
+}
+
+// the panel's routes are left alone, it would only set them straight back
+void ModMatrix::endSetRoute(uint8_t lPayloadLength, bool lIsComplete)
+{
+    if(!lIsComplete || lPayloadLength != 4 || mSysexArgs[0] < MOD_ROUTE_USER_FIRST || mSysexArgs[0] >= MOD_ROUTES ||
+        mSysexArgs[1] >= NUM_MOD_SOURCES || mSysexArgs[2] >= NUM_MOD_DESTINATIONS)
+    {
+        return;
+    }
+    int lDepth = (static_cast<int>(mSysexArgs[3]) - 0x40) * 2;
+    lDepth = lDepth < -MOD_DEPTH_MAX ? -MOD_DEPTH_MAX : lDepth;
+    setRoute(mSysexArgs[0], static_cast<MOD_SOURCES>(mSysexArgs[1]), static_cast<MOD_DESTINATIONS>(mSysexArgs[2]), lDepth);
+}
@@ -0,0 +1,100 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/* ModMatrix Class
+ *
+ * Routes from a source (MOD_SOURCES in typedefs.h) to a destination (MOD_DESTINATIONS) with a depth of -127 to 127.
+ * Sources are -127 to 127 (LFO) or 0 to 127 (everything else), one value per voice plus MOD_GLOBAL:
+ * - LFO: each voice's phase of the panel LFO. MOD_GLOBAL is the LFO without a voice offset
+ * - wheel: MOD_GLOBAL only
+ * - velocity, envelope (VCA level before the matrix) and MPE pressure: per voice, MOD_GLOBAL is the loudest or the last
+ * Destinations come out per voice (pitch, VCA) or in MOD_GLOBAL (LPF, LFO rate), each route adding source * depth / 128:
+ * - pitch: in pitchBendIncrements, so a full route is a semitone
+ * - VCA and LPF: applyLevel() scales the CV by 1 + output / 128. the LPF starts from the loudest VCA like it always has
+ * - LFO rate: the rate knob only ever gets pushed up, 0 - 127 is 0 - 1016 on the knob
+ * the LPF and LFO rate take the LFO as 0 to 127, the lowest point of the wave being no change.
+ *
+ * Only routes with a depth end up in the flat mActive list, and outputs are only worked out again for the destinations
+ * whose sources changed since the last update(). So a route nobody uses costs nothing and every route costs one multiply
+ * per voice at most when its source moves.
+ *
+ * The panel's own modulation is the first few routes, with depths set by the knobs and mod wheel switches every loop.
+ * The rest are free:
+ *   F0 7D 06 <route> <source> <destination> <depth, 40 is none> F7   route MOD_ROUTE_USER_FIRST - MOD_ROUTES-1.
+ *   depth goes in steps of 2 either side of 40
+*/
+
+#include <stdint.h>
+#include "typedefs.h"
+
+#ifndef MODMATRIX_H
+#define MODMATRIX_H
+
+#define MOD_ROUTES 8
+#define MOD_GLOBAL NUM_VOICES       //column for whatever isn't per voice
+#define MOD_COLUMNS (NUM_VOICES + 1)
+#define MOD_DEPTH_MAX 127
+#define MOD_TLC_MAX 4095
+
+//the panel's routes
+#define MOD_ROUTE_PANEL_VCO 0       //LFO to pitch, LFO VCO amount knob
+#define MOD_ROUTE_PANEL_VCF 1       //LFO to LPF, LFO VCF amount knob, closing the filter
+#define MOD_ROUTE_PANEL_FREQ 2      //wheel to LFO rate, with the mod wheel switch
+#define MOD_ROUTE_MPE_PRESSURE 3    //pressure to VCA while an MPE zone is on
+#define MOD_ROUTE_USER_FIRST 4
+
+#define MOD_VOICE_DESTINATIONS ((1 << MOD_DST_PITCH) | (1 << MOD_DST_VCA))
+#define MOD_UNIPOLAR_DESTINATIONS ((1 << MOD_DST_LPF) | (1 << MOD_DST_LFO_RATE))
+#define MOD_BIPOLAR_SOURCES (1 << MOD_SRC_LFO)
+#define MOD_GLOBAL_SOURCES (1 << MOD_SRC_WHEEL)
+
+typedef struct ModRoute
+{
+    uint8_t source;
+    uint8_t destination;
+    int8_t depth;
+} ModRoute;
+
+class ModMatrix
+{
+    public:
+    ModMatrix();
+    ~ModMatrix();
+
+    ModRoute mRoutes[MOD_ROUTES];
+    uint8_t mActive[MOD_ROUTES];                        //the routes with a depth, in route order
+    uint8_t mActiveCount;
+    uint8_t mSourceDestinations[NUM_MOD_SOURCES];       //bit per destination an active route takes this source to
+    int8_t mSource[NUM_MOD_SOURCES][MOD_COLUMNS];
+    int mOutput[NUM_MOD_DESTINATIONS][MOD_COLUMNS];
+    uint8_t mDirty;                                     //bit per destination to work out again
+    uint8_t mSysexArgs[4];
+
+    void setRoute(uint8_t lRoute, MOD_SOURCES lSource, MOD_DESTINATIONS lDestination, int8_t lDepth);
+    void setDepth(uint8_t lRoute, int8_t lDepth);
+    void setSource(MOD_SOURCES lSource, uint8_t lColumn, int lValue);
+    void update();
+    int output(MOD_DESTINATIONS lDestination, uint8_t lColumn);
+    unsigned int applyLevel(MOD_DESTINATIONS lDestination, uint8_t lColumn, unsigned int lCv);
+
+    // SysEx 06, see midiutils.h
+    void sysexByte(uint8_t lIndex, uint8_t lByte);
+    void endSetRoute(uint8_t lPayloadLength, bool lIsComplete);
+
+    private:
+    void compile();
+};
+
+#endif // MODMATRIX_H
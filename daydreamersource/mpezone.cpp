@@ -0,0 +1,205 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "mpezone.h"
+#include "pitchgenerator.h"
+
+#define MPE_TLC_MAX 4095
+
+MpeZone::MpeZone()
+{
+    // no members, so isMember() is false for every channel
+    mFirstMember = 1;
+    mLastMember = 0;
+    mBendRange = MPE_BEND_RANGE_DEFAULT;
+    for(uint8_t lChannel = 0; lChannel < MPE_CHANNELS; lChannel++)
+    {
+        mChannels[lChannel].bend = 0;
+        mChannels[lChannel].pressure = 0;
+        mChannels[lChannel].timbre = MPE_TIMBRE_CENTRE;
+    }
+    for(uint8_t lVoice = 0; lVoice < NUM_VOICES; lVoice++)
+    {
+        mVoiceChannel[lVoice] = MPE_NONE;
+        mVoiceNote[lVoice] = 0;
+        mVoiceOrder[lVoice] = lVoice;
+    }
+    mHeld = 0;
+    mSustained = 0;
+}
+
+MpeZone::~MpeZone(){}
+
+// the spec resets everything on a configuration message. the sketch releases the voices with releaseAll()
+void MpeZone::configure(uint8_t lManager, uint8_t lMembers)
+{
+    if(lManager == MPE_CHANNELS - 1)
+    {
+        lMembers = lMembers > lManager ? lManager : lMembers;
+        mFirstMember = lManager - lMembers;
+        mLastMember = lManager - 1;
+    }
+    else
+    {
+        lMembers = lMembers > MPE_CHANNELS - 1 - lManager ? MPE_CHANNELS - 1 - lManager : lMembers;
+        mFirstMember = lManager + 1;
+        mLastMember = lManager + lMembers;
+    }
+    mBendRange = MPE_BEND_RANGE_DEFAULT;
+    for(uint8_t lChannel = 0; lChannel < MPE_CHANNELS; lChannel++)
+    {
+        mChannels[lChannel].bend = 0;
+        mChannels[lChannel].pressure = 0;
+        mChannels[lChannel].timbre = MPE_TIMBRE_CENTRE;
+    }
+}
+
+bool MpeZone::isEnabled()
+{
+    return mFirstMember <= mLastMember;
+}
+
+bool MpeZone::isMember(uint8_t lChannel)
+{
+    return lChannel >= mFirstMember && lChannel <= mLastMember;
+}
+
+void MpeZone::setBend(uint8_t lChannel, uint8_t lLsb, uint8_t lMsb)
+{
+    long lRaw = static_cast<long>(lLsb | (lMsb << 7)) - 8192;
+    mChannels[lChannel].bend = (lRaw * mBendRange * pitchBendIncrements) >> 13;
+}
+
+void MpeZone::setPressure(uint8_t lChannel, uint8_t lPressure)
+{
+    mChannels[lChannel].pressure = lPressure;
+}
+
+void MpeZone::setTimbre(uint8_t lChannel, uint8_t lTimbre)
+{
+    mChannels[lChannel].timbre = lTimbre;
+}
+
+// bends already in the table keep the old range until their channel sends the next one
+void MpeZone::setBendRange(uint8_t lSemitones)
+{
+    mBendRange = lSemitones < 1 ? 1 : (lSemitones > MPE_BEND_RANGE_MAX ? MPE_BEND_RANGE_MAX : lSemitones);
+}
+
+uint8_t MpeZone::noteOn(uint8_t lChannel, uint8_t lNote)
+{
+    uint8_t lBusy = mHeld | mSustained;
+    uint8_t lOrderIndex = 0;
+    // a channel only plays one note at a time, so a new note on it takes over its voice
+    while(lOrderIndex < NUM_VOICES && !(mVoiceChannel[mVoiceOrder[lOrderIndex]] == lChannel && (lBusy & (1 << mVoiceOrder[lOrderIndex]))))
+    {
+        lOrderIndex++;
+    }
+    // otherwise the voice that was let go of longest ago
+    if(lOrderIndex == NUM_VOICES)
+    {
+        lOrderIndex = 0;
+        while(lOrderIndex < NUM_VOICES && (lBusy & (1 << mVoiceOrder[lOrderIndex])))
+        {
+            lOrderIndex++;
+        }
+    }
+    // otherwise steal the oldest note
+    if(lOrderIndex == NUM_VOICES)
+    {
+        lOrderIndex = 0;
+    }
+
+    uint8_t lVoice = mVoiceOrder[lOrderIndex];
+    for(; lOrderIndex < NUM_VOICES - 1; lOrderIndex++)
+    {
+        mVoiceOrder[lOrderIndex] = mVoiceOrder[lOrderIndex + 1];
+    }
+    mVoiceOrder[NUM_VOICES - 1] = lVoice;
+
+    mVoiceChannel[lVoice] = lChannel;
+    mVoiceNote[lVoice] = lNote;
+    mHeld |= (1 << lVoice);
+    mSustained &= ~(1 << lVoice);
+    return lVoice;
+}
+
+uint8_t MpeZone::noteOff(uint8_t lChannel, uint8_t lNote, bool lSustainIsOn)
+{
+    for(uint8_t lVoice = 0; lVoice < NUM_VOICES; lVoice++)
+    {
+        if((mHeld & (1 << lVoice)) && mVoiceChannel[lVoice] == lChannel && mVoiceNote[lVoice] == lNote)
+        {
+            mHeld &= ~(1 << lVoice);
+            if(lSustainIsOn)
+            {
+                mSustained |= (1 << lVoice);
+                return MPE_NONE;
+            }
+            return lVoice;
+        }
+    }
+    return MPE_NONE;
+}
+
+uint8_t MpeZone::sustainOff()
+{
+    uint8_t lRelease = mSustained;
+    mSustained = 0;
+    return lRelease;
+}
+
+uint8_t MpeZone::releaseAll()
+{
+    uint8_t lRelease = mHeld | mSustained;
+    mHeld = 0;
+    mSustained = 0;
+    return lRelease;
+}
+
+int MpeZone::voiceBend(uint8_t lVoice)
+{
+    return mVoiceChannel[lVoice] == MPE_NONE ? 0 : mChannels[mVoiceChannel[lVoice]].bend;
+}
+
+// only while the key is down. the release is the envelope's alone
+uint8_t MpeZone::voicePressure(uint8_t lVoice)
+{
+    return (mHeld & (1 << lVoice)) ? mChannels[mVoiceChannel[lVoice]].pressure : 0;
+}
+
+unsigned int MpeZone::timbreLevel(unsigned int lLpf)
+{
+    uint8_t lTimbre = 0;
+    bool lAnyHeld = false;
+    for(uint8_t lVoice = 0; lVoice < NUM_VOICES; lVoice++)
+    {
+        if(mHeld & (1 << lVoice))
+        {
+            uint8_t lVoiceTimbre = mChannels[mVoiceChannel[lVoice]].timbre;
+            lTimbre = lVoiceTimbre > lTimbre ? lVoiceTimbre : lTimbre;
+            lAnyHeld = true;
+        }
+    }
+    if(!lAnyHeld || lTimbre == MPE_TIMBRE_CENTRE)
+    {
+        return lLpf;
+    }
+    if(lTimbre > MPE_TIMBRE_CENTRE)
+    {
+        return lLpf + ((static_cast<unsigned long>(MPE_TLC_MAX - lLpf) * (lTimbre - MPE_TIMBRE_CENTRE)) >> 6);
+    }
+    return (static_cast<unsigned long>(lLpf) * lTimbre) >> 6;
+}
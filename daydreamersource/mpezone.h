@@ -0,0 +1,96 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/* MpeZone Class
+ *
+ * MIDI Polyphonic Expression. The channel set on the MIDI channel switches is the zone's manager channel,
+ * and the member channels next to it each carry one note with its own bend, pressure and timbre (CC74).
+ *
+ * The zone is set up with the MPE configuration message, RPN 6 on the manager channel:
+ *   Bn 65 00  Bn 64 06  Bn 06 <member channels, 0 turns MPE off>
+ * members go up from the manager, or down from it when the manager is channel 16, like the MPE upper zone.
+ * RPN 0 on a member channel sets the bend range of every member, 48 semitones until then.
+ *
+ * Expression is kept per channel in mChannels, and the parser drops it straight in there (see midiutils.h),
+ * so a stream of it costs a few bytes of parsing and nothing more. Each loop() reads it back once per voice:
+ * - voiceBend(): bend of the channel playing the voice, added to the voice's pitch
+ * - voicePressure(): the channel's pressure while the key is down, the MOD_SRC_PRESSURE source (see modmatrix.h)
+ * - timbreLevel(): there is only the one LPF, so it follows the highest CC74 of the notes being held.
+ *   64 leaves it where it is
+ *
+ * While the zone is on, gPolyphonyStatus is POLY_MPE and the voices are handed out here instead of by the
+ * polyphony switches: a channel keeps its voice, then the longest released voice goes, then the oldest note.
+*/
+
+#include <stdint.h>
+#include "typedefs.h"
+
+#ifndef MPEZONE_H
+#define MPEZONE_H
+
+#define MPE_CHANNELS 16
+#define MPE_NONE 0xFF
+#define MPE_BEND_RANGE_DEFAULT 48       //what the MPE spec has members start at
+#define MPE_BEND_RANGE_MAX 96
+#define MPE_TIMBRE_CENTRE 64
+#define MPE_PARSE_BYTES_PER_LOOP 8      //how far getMidiStates() reads ahead while the zone is on
+
+typedef struct MpeChannel
+{
+    int16_t bend;           //in pitchBendIncrements, already scaled by the bend range
+    uint8_t pressure;
+    uint8_t timbre;
+} MpeChannel;
+
+class MpeZone
+{
+    public:
+    MpeZone();
+    ~MpeZone();
+
+    uint8_t mFirstMember;
+    uint8_t mLastMember;
+    uint8_t mBendRange;
+    MpeChannel mChannels[MPE_CHANNELS];
+
+    uint8_t mVoiceChannel[NUM_VOICES];
+    uint8_t mVoiceNote[NUM_VOICES];
+    uint8_t mVoiceOrder[NUM_VOICES];    //least recently started first
+    uint8_t mHeld;                      //bit per voice with its key down
+    uint8_t mSustained;                 //bit per voice whose key went up under the sustain pedal
+
+    void configure(uint8_t lManager, uint8_t lMembers);
+    bool isEnabled();
+    bool isMember(uint8_t lChannel);
+
+    // expression, straight from the parser
+    void setBend(uint8_t lChannel, uint8_t lLsb, uint8_t lMsb);
+    void setPressure(uint8_t lChannel, uint8_t lPressure);
+    void setTimbre(uint8_t lChannel, uint8_t lTimbre);
+    void setBendRange(uint8_t lSemitones);
+
+    // voices. noteOn() always returns a voice, noteOff() MPE_NONE if nothing is to be released
+    uint8_t noteOn(uint8_t lChannel, uint8_t lNote);
+    uint8_t noteOff(uint8_t lChannel, uint8_t lNote, bool lSustainIsOn);
+    uint8_t sustainOff();       //bit per voice to release
+    uint8_t releaseAll();       //bit per voice to release
+
+    // read back once per loop
+    int voiceBend(uint8_t lVoice);
+    uint8_t voicePressure(uint8_t lVoice);
+    unsigned int timbreLevel(unsigned int lLpf);
+};
+
+#endif // MPEZONE_H
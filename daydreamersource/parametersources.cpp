@@ -0,0 +1,271 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "parametersources.h"
+#include "eepromlayout.h"
+#include <avr/pgmspace.h>
+
+// default CC for each parameter, in PARAMETERS order. the GM2 sound controllers where there is one
+const PROGMEM uint8_t gDefaultParameterCc[NUM_PARAMS] = {
+    73,     //attack time
+    75,     //decay time
+    79,     //sustain level (sound controller 10, no GM2 meaning)
+    72,     //release time
+    5,      //portamento time
+    76,     //vibrato rate
+    78,     //LFO to VCF (sound controller 9)
+    77      //vibrato depth
+};
+
+// CCs the firmware already answers to (see midiutils.h). mapCc() won't hand any of them to a parameter
+#define PARAM_RESERVED_CCS 11
+const PROGMEM uint8_t gReservedCc[PARAM_RESERVED_CCS] = {
+    1,      //modulation
+    6,      //data entry
+    64,     //sustain pedal
+    74,     //MPE timbre
+    80,     //LFO key sync
+    94,     //unison spread
+    95,     //LFO phase spread
+    98,     //NRPN LSB
+    99,     //NRPN MSB
+    100,    //RPN LSB
+    101     //RPN MSB
+};
+
+// mPickupSide is -1 or 1 while the knob is below or above the value
+#define PICKUP_CAUGHT 0
+#define PICKUP_PENDING 2    //side not known yet, set from the next reading
+
+static int slotAddress(uint8_t lSlot)
+{
+    return EEPROM_PRESET_START + lSlot * EEPROM_PRESET_SLOT_SIZE;
+}
+
+ParameterSources::ParameterSources()
+{
+    for(uint8_t lParam = 0; lParam < NUM_PARAMS; lParam++)
+    {
+        mValue[lParam] = 0;
+        mSource[lParam] = SOURCE_KNOB;
+        mCc[lParam] = pgm_read_byte_near(gDefaultParameterCc + lParam);
+        mKnobReading[lParam] = 0;
+        mPickupSide[lParam] = PICKUP_CAUGHT;
+    }
+    mWatchParam = 0;
+    mWatchCountdown = PARAM_WATCH_LOOPS;
+    mSysexArgs[0] = 0;
+    mSysexArgs[1] = 0;
+    for(uint8_t lParam = 0; lParam < NUM_PARAMS; lParam++)
+    {
+        mSaveValue[lParam] = 0;
+    }
+    mSaveSlot = 0;
+}
+
+ParameterSources::~ParameterSources(){}
+
+bool ParameterSources::wantsKnob(uint8_t lParam)
+{
+    return mSource[lParam] == SOURCE_KNOB || (mWatchCountdown == 0 && lParam == mWatchParam);
+}
+
+void ParameterSources::setKnobReading(uint8_t lParam, int lReading)
+{
+    if(mSource[lParam] != SOURCE_KNOB)
+    {
+        // being watched. a real turn hands the parameter back, the knob still has to catch the value first
+        int lMoved = lReading - mKnobReading[lParam];
+        if(lMoved <= PARAM_WATCH_THRESHOLD && lMoved >= -PARAM_WATCH_THRESHOLD)
+        {
+            return;
+        }
+        useKnob(lParam);
+    }
+    mKnobReading[lParam] = lReading;
+
+    if(mPickupSide[lParam] != PICKUP_CAUGHT)
+    {
+        int lDistance = lReading - mValue[lParam];
+        int8_t lSide = (lDistance > 0) ? 1 : -1;
+        bool lClose = (lDistance <= PARAM_PICKUP_WINDOW && lDistance >= -PARAM_PICKUP_WINDOW);
+        // caught when it is close, or when it went straight past the value between two readings
+        if(!lClose && (mPickupSide[lParam] == PICKUP_PENDING || lSide == mPickupSide[lParam]))
+        {
+            mPickupSide[lParam] = lSide;
+            return;
+        }
+        mPickupSide[lParam] = PICKUP_CAUGHT;
+    }
+    mValue[lParam] = lReading;
+}
+
+// moves the watch on to the next parameter that isn't on its knob
+void ParameterSources::endScan()
+{
+    if(mWatchCountdown > 0)
+    {
+        mWatchCountdown--;
+        return;
+    }
+    mWatchCountdown = PARAM_WATCH_LOOPS;
+    for(uint8_t i = 0; i < NUM_PARAMS; i++)
+    {
+        mWatchParam = (mWatchParam + 1) % NUM_PARAMS;
+        if(mSource[mWatchParam] != SOURCE_KNOB)
+        {
+            break;
+        }
+    }
+}
+
+// returns true if the CC drives a parameter
+bool ParameterSources::handleControl(uint8_t lCc, uint8_t lValue)
+{
+    bool lMapped = false;
+    for(uint8_t lParam = 0; lParam < NUM_PARAMS; lParam++)
+    {
+        if(mCc[lParam] == lCc)
+        {
+            mValue[lParam] = (lValue << 3) | (lValue >> 4);    //0 - 127 to 0 - 1023
+            mSource[lParam] = SOURCE_CC;
+            mPickupSide[lParam] = PICKUP_CAUGHT;
+            lMapped = true;
+        }
+    }
+    return lMapped;
+}
+
+// a reserved CC leaves the parameter mapped as it was
+void ParameterSources::mapCc(uint8_t lParam, uint8_t lCc)
+{
+    if(lParam >= NUM_PARAMS)
+    {
+        return;
+    }
+    for(uint8_t lReserved = 0; lReserved < PARAM_RESERVED_CCS; lReserved++)
+    {
+        if(pgm_read_byte_near(gReservedCc + lReserved) == lCc)
+        {
+            return;
+        }
+    }
+    mCc[lParam] = lCc;
+    if(lCc == PARAM_CC_NONE && mSource[lParam] == SOURCE_CC)
+    {
+        useKnob(lParam);
+    }
+}
+
+void ParameterSources::useKnob(uint8_t lParam)
+{
+    if(mSource[lParam] == SOURCE_KNOB)
+    {
+        return;
+    }
+    mSource[lParam] = SOURCE_KNOB;
+    mPickupSide[lParam] = PICKUP_PENDING;
+}
+
+void ParameterSources::useAllKnobs()
+{
+    for(uint8_t lParam = 0; lParam < NUM_PARAMS; lParam++)
+    {
+        useKnob(lParam);
+    }
+}
+
+// returns false and changes nothing if the slot has never been saved
+bool ParameterSources::loadPreset(uint8_t lSlot)
+{
+    if(lSlot >= EEPROM_PRESET_SLOTS)
+    {
+        return false;
+    }
+    int lAddress = slotAddress(lSlot);
+    if(EEPROM.read(lAddress) != EEPROM_PRESET_MAGIC)
+    {
+        return false;
+    }
+    uint8_t lChecksum = 0;
+    for(uint8_t i = 0; i < 2 * NUM_PARAMS; i++)
+    {
+        lChecksum += EEPROM.read(lAddress + 1 + i);
+    }
+    if(lChecksum != EEPROM.read(lAddress + 1 + 2 * NUM_PARAMS))
+    {
+        return false;
+    }
+
+    for(uint8_t lParam = 0; lParam < NUM_PARAMS; lParam++)
+    {
+        int lValue = EEPROM.read(lAddress + 1 + 2 * lParam) | (EEPROM.read(lAddress + 2 + 2 * lParam) << 8);
+        mValue[lParam] = lValue > PARAM_VALUE_MAX ? PARAM_VALUE_MAX : lValue;
+        mSource[lParam] = SOURCE_PRESET;
+        mPickupSide[lParam] = PICKUP_CAUGHT;
+    }
+    return true;
+}
+
+static uint8_t presetByte(void *lOwner, uint8_t, uint8_t lIndex)
+{
+    return static_cast<ParameterSources *>(lOwner)->savedByte(lIndex);
+}
+
+// every parameter as two bytes, low then high
+uint8_t ParameterSources::savedByte(uint8_t lIndex)
+{
+    int lValue = mSaveValue[lIndex >> 1];
+    return (lIndex & 1) ? lValue >> 8 : lValue & 0xFF;
+}
+
+// queues the save with gEepromWriter. false if the slot is out of range or another slot is still being saved
+bool ParameterSources::savePreset(uint8_t lSlot)
+{
+    if(lSlot >= EEPROM_PRESET_SLOTS || (lSlot != mSaveSlot && gEepromWriter.isQueued(slotAddress(mSaveSlot))))
+    {
+        return false;
+    }
+    mSaveSlot = lSlot;
+    for(uint8_t lParam = 0; lParam < NUM_PARAMS; lParam++)
+    {
+        mSaveValue[lParam] = mValue[lParam];
+    }
+    return gEepromWriter.queue(slotAddress(lSlot), 2 * NUM_PARAMS, EEPROM_PRESET_MAGIC, presetByte, this, lSlot);
+}
+
+void ParameterSources::sysexByte(uint8_t lIndex, uint8_t lByte)
+{
+    if(lIndex < sizeof(mSysexArgs))
+    {
+        mSysexArgs[lIndex] = lByte;
+    }
+}
+
+void ParameterSources::endMapCc(uint8_t lPayloadLength, bool lIsComplete)
+{
+    if(lIsComplete && lPayloadLength == 2)
+    {
+        mapCc(mSysexArgs[0], mSysexArgs[1]);
+    }
+}
+
+void ParameterSources::endSavePreset(uint8_t lPayloadLength, bool lIsComplete)
+{
+    if(lIsComplete && lPayloadLength == 1)
+    {
+        savePreset(mSysexArgs[0]);
+    }
+}
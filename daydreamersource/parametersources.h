@@ -0,0 +1,89 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/* ParameterSources Class
+ *
+ * Every sound parameter (PARAMETERS in typedefs.h) gets its value, 0 - 1023, from one of three places:
+ * - SOURCE_KNOB: its panel knob
+ * - SOURCE_CC: a MIDI CC. receiving the mapped CC moves the parameter over to it, so DAW automation just works
+ * - SOURCE_PRESET: a slot in EEPROM (see eepromlayout.h), recalled with a program change
+ *
+ * Only knobs that are the active source are read every loop. The rest are looked at one every PARAM_WATCH_LOOPS loops,
+ * and turning one more than PARAM_WATCH_THRESHOLD gives its parameter back to the knob.
+ * A knob that gets control back uses soft takeover: it only takes over once it reaches the current value
+ * (within PARAM_PICKUP_WINDOW or by passing it), so nothing jumps.
+ *
+ * The sketch does the reading, since the mux lives there:
+ *   for each parameter: if(wantsKnob(p)) setKnobReading(p, <ADC>);  then endScan()
+ *
+ * MIDI (see midiutils.h):
+ *   F0 7D 03 <parameter> <cc number> F7   maps a CC to a parameter. 7F unmaps it and gives the parameter back to the knob
+ *                                         CCs the firmware uses itself are ignored, the list is in midiutils.h
+ *   F0 7D 04 <slot> F7                    saves the current values into a preset slot. they are copied into mSaveValue
+ *                                         and written in the background (see eepromlayout.h), so a save of another
+ *                                         slot that comes before that has finished is ignored
+ *   program change 0 - 7                  recalls a slot. 7F gives every parameter back to its knob
+*/
+
+#include <stdint.h>
+#include "typedefs.h"
+
+#ifndef PARAMETERSOURCES_H
+#define PARAMETERSOURCES_H
+
+#define PARAM_VALUE_MAX 1023
+#define PARAM_PICKUP_WINDOW 16      //knob counts either side of the value that count as caught
+#define PARAM_WATCH_LOOPS 32        //loops between looking at a knob that isn't the source
+#define PARAM_WATCH_THRESHOLD 48    //how far an inactive knob has to move before it takes its parameter back
+#define PARAM_CC_NONE 0x7F
+#define PRESET_PANEL_PROGRAM 0x7F
+
+class ParameterSources
+{
+    public:
+    ParameterSources();
+    ~ParameterSources();
+
+    int mValue[NUM_PARAMS];
+    PARAMETER_SOURCES mSource[NUM_PARAMS];
+    uint8_t mCc[NUM_PARAMS];
+    int mKnobReading[NUM_PARAMS];       //last reading, kept while the knob isn't the source to spot it being turned
+    int8_t mPickupSide[NUM_PARAMS];     //soft takeover state, see parametersources.cpp
+
+    uint8_t mWatchParam;
+    uint8_t mWatchCountdown;
+    uint8_t mSysexArgs[2];
+    int mSaveValue[NUM_PARAMS];         //what the preset save in gEepromWriter is writing
+    uint8_t mSaveSlot;
+
+    bool wantsKnob(uint8_t lParam);
+    void setKnobReading(uint8_t lParam, int lReading);
+    void endScan();
+
+    bool handleControl(uint8_t lCc, uint8_t lValue);
+    void mapCc(uint8_t lParam, uint8_t lCc);
+    void useKnob(uint8_t lParam);
+    void useAllKnobs();
+
+    bool loadPreset(uint8_t lSlot);
+    bool savePreset(uint8_t lSlot);
+    uint8_t savedByte(uint8_t lIndex);
+
+    void sysexByte(uint8_t lIndex, uint8_t lByte);
+    void endMapCc(uint8_t lPayloadLength, bool lIsComplete);
+    void endSavePreset(uint8_t lPayloadLength, bool lIsComplete);
+};
+
+#endif // PARAMETERSOURCES_H
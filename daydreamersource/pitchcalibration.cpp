@@ -0,0 +1,158 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "pitchcalibration.h"
+#include "eepromlayout.h"
+#include <EEPROM.h>
+
+#define NO_UPLOAD_VOICE 0xFF
+
+// address of a voice's magic. the deltas follow it and the checksum sits right after the last delta
+static int voiceAddress(uint8_t lVoice)
+{
+    return EEPROM_PITCH_CAL_START + lVoice * EEPROM_PITCH_CAL_VOICE_SIZE;
+}
+
+PitchCalibration::PitchCalibration()
+{
+    for(uint8_t lVoice = 0; lVoice < NUM_VOICES; lVoice++)
+    {
+        clearVoice(lVoice);
+    }
+    mUploadVoice = NO_UPLOAD_VOICE;
+    mUploadCount = 0;
+    mUploadOffset = 0;
+}
+
+PitchCalibration::~PitchCalibration(){}
+
+void PitchCalibration::clearVoice(uint8_t lVoice)
+{
+    for(uint8_t lIndex = 0; lIndex < tlcTableLength; lIndex++)
+    {
+        mOffsets[lVoice][lIndex] = 0;
+    }
+}
+
+// keeps the corrected table usable: 0 - 4095, and never lower than the entry before it
+void PitchCalibration::setOffset(int8_t *lOffsets, uint8_t lIndex, int lOffset)
+{
+    lOffset = lOffset < -128 ? -128 : lOffset;
+    lOffset = lOffset > 127 ? 127 : lOffset;
+
+    int lBase = pgm_read_word_near(gTlcValues + lIndex);
+    int lValue = lBase + lOffset;
+    int lFloor = (lIndex == 0) ? 0 : pgm_read_word_near(gTlcValues + lIndex - 1) + lOffsets[lIndex - 1];
+    lValue = lValue < lFloor ? lFloor : lValue;
+    lValue = lValue > 4095 ? 4095 : lValue;
+
+    lOffsets[lIndex] = lValue - lBase;
+}
+
+// returns false if any voice hasn't been saved yet. those voices are left uncalibrated
+bool PitchCalibration::loadFromEeprom()
+{
+    bool lAllGood = true;
+    for(uint8_t lVoice = 0; lVoice < NUM_VOICES; lVoice++)
+    {
+        lAllGood = loadVoice(lVoice) && lAllGood;
+    }
+    return lAllGood;
+}
+
+bool PitchCalibration::loadVoice(uint8_t lVoice)
+{
+    clearVoice(lVoice);
+    int lAddress = voiceAddress(lVoice);
+    if(EEPROM.read(lAddress) != EEPROM_PITCH_CAL_MAGIC)
+    {
+        return false;
+    }
+
+    uint8_t lChecksum = 0;
+    for(uint8_t lIndex = 0; lIndex < tlcTableLength; lIndex++)
+    {
+        lChecksum += EEPROM.read(lAddress + 1 + lIndex);
+    }
+    if(lChecksum != EEPROM.read(lAddress + 1 + tlcTableLength))
+    {
+        return false;
+    }
+
+    // deltas are stored mod 256, so adding them up in a byte gets back the exact offset
+    uint8_t lRunning = 0;
+    for(uint8_t lIndex = 0; lIndex < tlcTableLength; lIndex++)
+    {
+        lRunning += EEPROM.read(lAddress + 1 + lIndex);
+        setOffset(mOffsets[lVoice], lIndex, static_cast<int8_t>(lRunning));
+    }
+    return true;
+}
+
+static uint8_t calibrationByte(void *lOwner, uint8_t lVoice, uint8_t lIndex)
+{
+    return static_cast<PitchCalibration *>(lOwner)->savedByte(lVoice, lIndex);
+}
+
+// the delta stored for one entry. they add up to the last offset, which is what the checksum comes to
+uint8_t PitchCalibration::savedByte(uint8_t lVoice, uint8_t lIndex)
+{
+    uint8_t lPrevious = lIndex ? static_cast<uint8_t>(mOffsets[lVoice][lIndex - 1]) : 0;
+    return static_cast<uint8_t>(mOffsets[lVoice][lIndex]) - lPrevious;
+}
+
+void PitchCalibration::saveVoice(uint8_t lVoice)
+{
+    gEepromWriter.queue(voiceAddress(lVoice), tlcTableLength, EEPROM_PITCH_CAL_MAGIC, calibrationByte, this, lVoice);
+}
+
+// lIndex 0 is the voice, after that one delta per table entry
+void PitchCalibration::uploadByte(uint8_t lIndex, uint8_t lByte)
+{
+    if(lIndex == 0)
+    {
+        mUploadVoice = (lByte < NUM_VOICES) ? lByte : NO_UPLOAD_VOICE;
+        mUploadCount = 0;
+        mUploadOffset = 0;
+        return;
+    }
+    if(mUploadVoice == NO_UPLOAD_VOICE || mUploadCount >= tlcTableLength)
+    {
+        return;
+    }
+
+    // 7 bit two's complement
+    int lDelta = (lByte & 0x40) ? static_cast<int>(lByte) - 128 : lByte;
+    mUploadOffset += lDelta;
+    setOffset(mUpload, mUploadCount, mUploadOffset);
+    mUploadCount++;
+}
+
+void PitchCalibration::endUpload(uint8_t lPayloadLength, bool lIsComplete)
+{
+    if(mUploadVoice == NO_UPLOAD_VOICE)
+    {
+        return;
+    }
+    if(lIsComplete && lPayloadLength == tlcTableLength + 1 && mUploadCount == tlcTableLength)
+    {
+        for(uint8_t lIndex = 0; lIndex < tlcTableLength; lIndex++)
+        {
+            mOffsets[mUploadVoice][lIndex] = mUpload[lIndex];
+        }
+        saveVoice(mUploadVoice);
+    }
+    mUploadVoice = NO_UPLOAD_VOICE;
+}
@@ -0,0 +1,70 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/* PitchCalibration Class
+ *
+ * Every analog VCO tracks a little differently, so each voice gets its own correction on top of gTlcValues.
+ *
+ * In EEPROM (see eepromlayout.h) a voice is stored as a magic byte, then one signed byte per table entry:
+ *   the first byte is the offset of entry 0 from gTlcValues, every byte after that is the change from the previous offset.
+ *   neighbouring notes usually drift together, so the deltas stay small. a checksum byte follows.
+ *   each voice has its own magic, so a voice that was never saved reads as uncalibrated whatever the others hold.
+ * At boot that is decoded into mOffsets, a signed byte per entry per voice.
+ * That is half the RAM of six full tables, and a lookup is one pgm_read_word_near plus one RAM byte.
+ * Reading the EEPROM per tick instead would stall for up to 3.3 ms whenever a save is writing.
+ *
+ * Decoding clamps every corrected entry to 0 - 4095 and never below the entry before it,
+ * so PitchGenerator can keep interpolating with unsigned maths.
+ *
+ * Upload over SysEx (see midiutils.h):
+ *   F0 7D 01 <voice> <tlcTableLength deltas, 7 bit two's complement (-64 to 63)> F7
+ *   the deltas are staged in mUpload and only swapped into mOffsets once the whole message is in, so a voice never
+ *   plays from a half new table. a short or broken off upload is dropped.
+ *   the save then goes out in the background through gEepromWriter (see eepromlayout.h), so it never holds up loop().
+*/
+
+#include <stdint.h>
+#include "typedefs.h"
+#include "pitchgenerator.h"
+
+#ifndef PITCHCALIBRATION_H
+#define PITCHCALIBRATION_H
+
+class PitchCalibration
+{
+    public:
+    PitchCalibration();
+    ~PitchCalibration();
+
+    int8_t mOffsets[NUM_VOICES][tlcTableLength];
+
+    //upload in progress
+    int8_t mUpload[tlcTableLength];
+    uint8_t mUploadVoice;
+    uint8_t mUploadCount;
+    int mUploadOffset;
+
+    bool loadFromEeprom();
+    bool loadVoice(uint8_t lVoice);
+    void saveVoice(uint8_t lVoice);
+    uint8_t savedByte(uint8_t lVoice, uint8_t lIndex);
+    void clearVoice(uint8_t lVoice);
+    void setOffset(int8_t *lOffsets, uint8_t lIndex, int lOffset);
+
+    void uploadByte(uint8_t lIndex, uint8_t lByte);
+    void endUpload(uint8_t lPayloadLength, bool lIsComplete);
+};
+
+#endif // PITCHCALIBRATION_H
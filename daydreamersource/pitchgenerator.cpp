@@ -15,6 +15,7 @@
 
 #include "pitchgenerator.h"
 #include <HardwareSerial.h>
+#include <stddef.h>
 
 PitchGenerator::PitchGenerator()
 {
@@ -23,8 +24,17 @@ PitchGenerator::PitchGenerator()
     mGlideLength = 0;   //0 TO 1023
     mLegatoOnlyGlide = false;
     mPitchAndLfoBend = 0;
+    mBendNote = 0;
+    mBendBaseIndex = 0;
+    mBendMin = 0;
+    mBendMax = 0;
+    mCalibration = NULL;
+    mDetune = 0;
+    mDetuneTlc = 0;
+    mDetuneNote = 0;
     //outputs
     mOutPitch = calculatePitchBendTlc(60); //c3;
+    mDitherError = 0;
 
     //calculations
     mDoNewGlide = true;
@@ -51,44 +61,102 @@ void PitchGenerator::setGlideLength(int lReading)
     mGlideLength = lReading;
 }
 
-// finds the output of midi note to TLC based on LFO and pitch bend input
+void PitchGenerator::setCalibration(const int8_t *lOffsets)
+{
+    mCalibration = lOffsets;
+}
+
+// gTlcValues entry with this voice's calibration on top
+unsigned int PitchGenerator::tlcAt(int lIndex)
+{
+    unsigned int lTlc = pgm_read_word_near(gTlcValues + lIndex);
+    return mCalibration ? lTlc + mCalibration[lIndex] : lTlc;
+}
+
+// caches where this note sits in gTlcValues and how far the table lets it bend each way
+void PitchGenerator::updateBendSpan(unsigned int lMidiByteIn)
+{
+    int lIndex = static_cast<int>(lMidiByteIn) - lowestMidi + noteLimitOffset;
+    const int lLastIndex = tlcTableLength - 1;
+    lIndex = lIndex < 0 ? 0 : lIndex;
+    lIndex = lIndex > lLastIndex ? lLastIndex : lIndex;
+
+    mBendNote = lMidiByteIn;
+    mBendBaseIndex = lIndex;
+    mBendMin = -lIndex * pitchBendIncrements;
+    mBendMax = (lLastIndex - lIndex) * pitchBendIncrements;
+}
+
+// finds the output of midi note to TLC based on LFO and pitch bend input, in 12.4
 unsigned int PitchGenerator::calculatePitchBendTlc(unsigned int lMidiByteIn)
 {
     /*
-    The memory is like this 
+    The bend is in 1/128 semitone steps, so it can land anywhere in the table, not just the next entry.
     .. _ _ [] _ _ 
-       ^lowest pitch bend, -100
-            ^ the real note
-                ^highest pitch bend, +100
-    ^ -200
-                        +200
+       ^ -256   ^ +256
+    the top bits pick the entry at or below the bent pitch, the low 7 bits interpolate towards the one above.
+    the interpolation keeps pitchFractionBits below the whole count instead of throwing them away.
+    past either end of the table it holds the end value.
+    the per tick cost is the same no matter how wide the bend range is.
     */
-    unsigned int pureTlc = pgm_read_word_near(gTlcValues + (lMidiByteIn - lowestMidi + noteLimitOffset));   //offset in memory for the pureTlc tone
-    static unsigned int pitchBentTlc;
-    unsigned int tlcCompare;
-    // mPitchAndLfoBend or gPitchBendScaled
-    if(mPitchAndLfoBend == 0)
-    {
-        pitchBentTlc = pureTlc;
-    }
-    else if (mPitchAndLfoBend > 0)
+    if(lMidiByteIn != mBendNote)
     {
-        tlcCompare = pgm_read_word_near(gTlcValues + (lMidiByteIn - lowestMidi + 2*noteLimitOffset));   //next full step note TLC value
-        pitchBentTlc = pureTlc + ((double)(tlcCompare - pureTlc)/pitchBendIncrements) * mPitchAndLfoBend;
-        pitchBentTlc = pitchBentTlc > 4095 ? 4095 : pitchBentTlc;
+        updateBendSpan(lMidiByteIn);
     }
-    else
+    return bentTlc(mPitchAndLfoBend);
+}
+
+// mBendNote bent by lBend, in 12.4
+unsigned int PitchGenerator::bentTlc(int lBend)
+{
+    lBend = lBend < mBendMin ? mBendMin : lBend;
+    lBend = lBend > mBendMax ? mBendMax : lBend;
+
+    int lIndex = mBendBaseIndex + (lBend >> pitchBendShift);    // >> floors negative bends, so lIndex is always at or below the pitch
+    unsigned int lFraction = lBend & (pitchBendIncrements - 1);
+    unsigned int lBaseTlc = tlcAt(lIndex);
+    unsigned int pitchBentTlc = lBaseTlc << pitchFractionBits;
+    if(lFraction)
     {
-        tlcCompare = pgm_read_word_near(gTlcValues + (lMidiByteIn - lowestMidi));   //previous full step note TLC value
-        pitchBentTlc = pureTlc + ((double)(pureTlc - tlcCompare)/pitchBendIncrements) * mPitchAndLfoBend;
-        pitchBentTlc = (int)pitchBentTlc < 0 ? 0 : pitchBentTlc;
+        unsigned int tlcCompare = tlcAt(lIndex + 1);   //next full step note TLC value
+        pitchBentTlc += ((tlcCompare - lBaseTlc) * lFraction) >> (pitchBendShift - pitchFractionBits);
     }
     
     return pitchBentTlc;
 }
 
+void PitchGenerator::setDetune(int lDetune)
+{
+    if(lDetune != mDetune)
+    {
+        mDetune = lDetune;
+        updateDetune(mTargetMidiByte);
+    }
+}
 
-// does gliding accounting for pitchBentTlc
+// the detune's size in TLC counts around this note. once per note or detune change, never per tick
+void PitchGenerator::updateDetune(unsigned int lMidiByteIn)
+{
+    if(lMidiByteIn != mBendNote)
+    {
+        updateBendSpan(lMidiByteIn);
+    }
+    mDetuneNote = lMidiByteIn;
+    mDetuneTlc = mDetune ? static_cast<int>(bentTlc(mDetune) - bentTlc(0)) : 0;
+}
+
+// first order sigma-delta. the part below a whole count builds up in mDitherError and carries into the next frame,
+// so the output flips between the two nearest counts and averages out to the 12.4 pitch. call once per Tlc.update()
+unsigned int PitchGenerator::ditherToTlc()
+{
+    long lSum = static_cast<long>(mOutPitch) + mDetuneTlc + mDitherError;     //12.4 of the top note doesn't fit an AVR int
+    lSum = lSum < 0 ? 0 : lSum;
+    mDitherError = lSum & pitchFractionMask;
+    lSum >>= pitchFractionBits;
+    return lSum > tlcMaxValue ? tlcMaxValue : lSum;
+}
+
+// does gliding accounting for pitchBentTlc. returns the TLC value for this frame
 unsigned int PitchGenerator::calculateOutPitch(unsigned int lMidiByteIn, ADSR_STATUSES lAdsrStatus)
 {
     mPrevEnvStatus = mCurrEnvStatus;
@@ -107,6 +175,10 @@ unsigned int PitchGenerator::calculateOutPitch(unsigned int lMidiByteIn, ADSR_ST
     }
 
     mTargetMidiByte = lMidiByteIn;
+    if(lMidiByteIn != mDetuneNote)
+    {
+        updateDetune(lMidiByteIn);
+    }
 
     if(mVcoMidiValueIsChanged)
     {
@@ -141,5 +213,5 @@ unsigned int PitchGenerator::calculateOutPitch(unsigned int lMidiByteIn, ADSR_ST
         mOutPitch = calculatePitchBendTlc(mTargetMidiByte);
         mDoNewGlide = false;
     }
-    return mOutPitch;
+    return ditherToTlc();
 }
\ No newline at end of file
@@ -26,6 +26,7 @@
  * - pitch in uint16_t for TLC
 */
 
+#include <stdint.h>
 #include "typedefs.h"
 #include <avr/pgmspace.h>
 
@@ -86,8 +87,20 @@ const PROGMEM unsigned int gTlcValues[] = {
 #define lowestMidi 36
 
 #define noteLimitOffset 2
+#define tlcTableLength (sizeof(gTlcValues) / sizeof(gTlcValues[0]))
 
-#define pitchBendIncrements 100
+// bends are in 1/128ths of a semitone. mPitchAndLfoBend = 128 is one semitone up.
+// the whole part picks the table entry, the low 7 bits interpolate to the next one
+#define pitchBendIncrements 128
+#define pitchBendShift 7
+#define pitchBendRangeDefault 2     // semitones, changed over RPN 0
+#define pitchBendRangeMax 12
+
+// pitch is worked out in 1/16ths of a TLC count (12.4 fixed point), so glides and small LFO depths move smoothly
+// even at the bottom where a semitone is only ~13 counts. ditherToTlc() brings it down to whole counts per frame
+#define pitchFractionBits 4
+#define pitchFractionMask ((1 << pitchFractionBits) - 1)
+#define tlcMaxValue 4095
 
 
 
@@ -103,24 +116,46 @@ class PitchGenerator
     bool mLegatoOnlyGlide;
     int mPitchAndLfoBend;
     //outputs
-    unsigned int mOutPitch;
+    unsigned int mOutPitch;     //12.4
+    uint8_t mDitherError;       //fraction carried into the next frame
 
     //calculations
     bool mDoNewGlide;
     bool mNotesAreFull;
     int mt_glide;
-    unsigned int mStartPitch;
-    unsigned int mNextPitch;
+    unsigned int mStartPitch;   //12.4
+    unsigned int mNextPitch;    //12.4
     bool mVcoMidiValueIsChanged;
     ADSR_STATUSES mCurrEnvStatus;
     ADSR_STATUSES mPrevEnvStatus;
     double mGlideSlope;
     int mTimeScalar;
 
+    // bend span of the current note, only recalculated when the note changes
+    unsigned int mBendNote;
+    int mBendBaseIndex;     //table index of the unbent note
+    int mBendMin;           //furthest the table lets this note bend down and up, in pitchBendIncrements
+    int mBendMax;
+
+    // this voice's offsets from gTlcValues, see pitchcalibration.h. NULL plays the table as it is
+    const int8_t *mCalibration;
+    // unison detune, in pitchBendIncrements. the table isn't straight, so it is turned into TLC counts (12.4)
+    // for each new note here and the tick only adds mDetuneTlc
+    int mDetune;
+    int mDetuneTlc;
+    unsigned int mDetuneNote;
+
     void setGlideLength(int lReading);
+    void setCalibration(const int8_t *lOffsets);
+    unsigned int tlcAt(int lIndex);
+    void updateBendSpan(unsigned int lMidiByteIn);
+    unsigned int bentTlc(int lBend);
     unsigned int calculatePitchBendTlc(unsigned int lMidiByteIn);
+    void setDetune(int lDetune);
+    void updateDetune(unsigned int lMidiByteIn);
     unsigned int calculateOutPitch(unsigned int lMidiByteIn, ADSR_STATUSES lAdsrStatus);
+    unsigned int ditherToTlc();
     void setLegatoOnlyGlide(bool lConstantOrLegato);
 };
 
-#endif PITCHGENERATOR_H
+#endif // PITCHGENERATOR_H
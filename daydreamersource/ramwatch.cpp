@@ -0,0 +1,108 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "ramwatch.h"
+#include <HardwareSerial.h>
+#include <avr/io.h>
+
+#ifndef HOST_BUILD
+
+// from the linker and avr-libc's malloc
+extern uint8_t _end;
+extern uint8_t __stack;
+extern uint8_t __heap_start;
+extern char *__brkval;
+
+// naked and in .init3: SP is set and r1 is zeroed, nothing has been pushed and no constructor has run yet.
+// painting right up to __stack is safe because the stack is still empty
+void ramWatchPaint() __attribute__((naked, used, section(".init3")));
+void ramWatchPaint()
+{
+    uint8_t *lByte = &_end;
+    while(lByte <= &__stack)
+    {
+        *lByte++ = RAM_PAINT;
+    }
+}
+
+static uint16_t heapTop()
+{
+    return __brkval ? reinterpret_cast<uint16_t>(__brkval) : reinterpret_cast<uint16_t>(&__heap_start);
+}
+
+#endif // HOST_BUILD
+
+RamWatch::RamWatch()
+{
+    mHeapTop = 0;
+    mMinFree = 0xFFFF;
+}
+
+RamWatch::~RamWatch(){}
+
+// once per loop(). a compare or two, no scan
+void RamWatch::update()
+{
+#ifndef HOST_BUILD
+    uint16_t lHeapTop = heapTop();
+    mHeapTop = lHeapTop > mHeapTop ? lHeapTop : mHeapTop;
+    uint16_t lFree = SP > lHeapTop ? SP - lHeapTop : 0;
+    mMinFree = lFree < mMinFree ? lFree : mMinFree;
+#endif
+}
+
+RamReport RamWatch::report()
+{
+    RamReport lReport;
+    lReport.staticBytes = 0;
+    lReport.heapBytes = 0;
+    lReport.stackBytes = 0;
+    lReport.freeBytes = 0;
+    lReport.minFreeBytes = 0;
+#ifndef HOST_BUILD
+    update();
+    uint16_t lRamStart = RAMSTART;
+    uint16_t lHeapStart = reinterpret_cast<uint16_t>(&__heap_start);
+    uint16_t lStackTop = reinterpret_cast<uint16_t>(&__stack);
+
+    // the lowest byte the stack has written is the first one above the heap that isn't paint
+    const uint8_t *lByte = reinterpret_cast<const uint8_t *>(mHeapTop);
+    while(lByte <= &__stack && *lByte == RAM_PAINT)
+    {
+        lByte++;
+    }
+    uint16_t lStackLow = reinterpret_cast<uint16_t>(lByte);
+    uint16_t lPaintedFree = lStackLow - mHeapTop;
+
+    lReport.staticBytes = lHeapStart - lRamStart;
+    lReport.heapBytes = mHeapTop - lHeapStart;
+    lReport.stackBytes = lStackTop + 1 - lStackLow;
+    lReport.freeBytes = SP - heapTop();
+    lReport.minFreeBytes = lPaintedFree < mMinFree ? lPaintedFree : mMinFree;
+#endif
+    return lReport;
+}
+
+void RamWatch::sendReport()
+{
+    RamReport lReport = report();
+    const uint8_t *lBytes = reinterpret_cast<const uint8_t *>(&lReport);
+    Serial.write('D');
+    Serial.write('R');
+    for(uint8_t i = 0; i < sizeof(lReport); i++)
+    {
+        Serial.write(lBytes[i]);
+    }
+}
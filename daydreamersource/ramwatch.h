@@ -0,0 +1,65 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/* RamWatch Class
+ *
+ * How close the stack has come to the heap in the 2 KB of SRAM.
+ *
+ * ramWatchPaint() runs from .init3, before the global constructors, and fills everything between the end of .bss
+ * and the top of RAM with RAM_PAINT. Whatever the heap or the stack writes over it is gone, so later on:
+ * - heap top: __brkval, the end of what malloc/new has handed out. update() keeps the highest it has been
+ * - stack high water: scanning up from the heap top, the first byte that isn't RAM_PAINT is as deep as the
+ *   stack has ever gone, interrupts included. update() doesn't scan, only report() does
+ * - free RAM: SP - heap top, sampled every loop() in update(). minFreeBytes is the smaller of the lowest
+ *   sample and the gap between the stack high water and the heap high water
+ *
+ * SysEx 07 (see midiutils.h) asks for a report. it goes out on the UART like the idle report:
+ *   'D' 'R' then RamReport, little endian
+ *
+ * What takes the static part (.data and .bss) is in the per object map from host/rammap.cpp.
+ * On the host build there is no AVR memory map and the report stays at 0.
+*/
+
+#include <stdint.h>
+
+#ifndef RAMWATCH_H
+#define RAMWATCH_H
+
+#define RAM_PAINT 0xC5              //unlikely to be a stack byte, not 0x00 or 0xFF
+
+typedef struct RamReport
+{
+    uint16_t staticBytes;       //.data and .bss, fixed when it is linked
+    uint16_t heapBytes;         //heap high water
+    uint16_t stackBytes;        //stack high water, from the paint
+    uint16_t freeBytes;         //between the heap top and SP when it was asked for
+    uint16_t minFreeBytes;      //the least there has been
+} RamReport;
+
+class RamWatch
+{
+    public:
+    RamWatch();
+    ~RamWatch();
+
+    uint16_t mHeapTop;          //highest __brkval seen
+    uint16_t mMinFree;          //lowest SP - heap top seen by update()
+
+    void update();
+    RamReport report();
+    void sendReport();
+};
+
+#endif // RAMWATCH_H
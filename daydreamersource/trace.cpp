@@ -0,0 +1,55 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "trace.h"
+
+#if TRACE_ENABLED
+
+#include <HardwareSerial.h>
+
+TraceRecord gTraceBuffer[TRACE_BUFFER_LENGTH];
+uint8_t gTraceHead = 0;
+uint8_t gTraceCount = 0;
+uint8_t gTraceLost = 0;
+volatile uint16_t gTraceTick = 0;
+bool gTraceFlushRequested = false;
+
+// blocks while the TX buffer drains, ~2 ms per record at 31250 baud. only call this when nothing is playing
+void traceFlush()
+{
+    Serial.write('D');
+    Serial.write('T');
+    Serial.write(gTraceCount);
+    Serial.write(gTraceLost);
+
+    uint8_t lIndex = (gTraceHead - gTraceCount) & (TRACE_BUFFER_LENGTH - 1);
+    for(uint8_t lSent = 0; lSent < gTraceCount; lSent++)
+    {
+        const TraceRecord &lRecord = gTraceBuffer[lIndex];
+        Serial.write(lRecord.tick & 0xFF);
+        Serial.write(lRecord.tick >> 8);
+        Serial.write(lRecord.subTick);
+        Serial.write(lRecord.event);
+        Serial.write(lRecord.arg1);
+        Serial.write(lRecord.arg2);
+        lIndex = (lIndex + 1) & (TRACE_BUFFER_LENGTH - 1);
+    }
+
+    gTraceCount = 0;
+    gTraceLost = 0;
+    gTraceFlushRequested = false;
+}
+
+#endif // TRACE_ENABLED
@@ -0,0 +1,124 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
+*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful, 
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with 
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/*
+	event trace
+	Serial.print in updateOutput or the poly switch breaks the timing. TRACE() instead copies a 6 byte record
+	into a RAM ring buffer, which is a handful of instructions. The ring is only sent out by traceFlush(),
+	which the loop calls when every voice is off, or when asked to over SysEx (F0 7D 02 F7).
+
+	set TRACE_ENABLED to 1 to turn it on. with it at 0 every TRACE() compiles to nothing and the buffer is not allocated.
+
+	time is the TIMER0 LFO tick (4.096 ms) plus TCNT0 (16 us), so it wraps every ~268 seconds.
+	the ring keeps the newest TRACE_BUFFER_LENGTH records. older ones are overwritten and counted as lost.
+
+	dump format on the serial TX pin:
+		'D' 'T' <count> <lost>, then count records oldest first: <tick LSB> <tick MSB> <TCNT0> <event> <arg1> <arg2>
+	host/tracedecode.cpp turns a capture of that into a timeline.
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_ENABLED 0
+#define TRACE_BUFFER_LENGTH 32      //must be a power of 2. 6 bytes each
+
+// host/tracedecode.cpp has a name for each of these. add new ones at the end
+typedef enum
+{
+    TRACE_NOTE_ON,          //note, velocity
+    TRACE_NOTE_OFF,         //note, 0
+    TRACE_VOICE_ASSIGN,     //slot, note
+    TRACE_VOICE_STEAL,      //slot, note that was stolen
+    TRACE_VOICE_FREE,       //slot, note
+    TRACE_ENV_STATE,        //voice, ADSR_STATUSES
+    TRACE_SUSTAIN,          //on, 0
+    TRACE_POLYPHONY         //POLYPHONY, 0
+} TRACE_EVENTS;
+
+typedef struct TraceRecord
+{
+    uint16_t tick;
+    uint8_t subTick;
+    uint8_t event;
+    uint8_t arg1;
+    uint8_t arg2;
+} TraceRecord;
+
+// the host decoder only wants the record layout and event ids
+#if defined(HOST_BUILD) && !defined(TRACE_DECODER)
+
+// the host tools count events as they happen instead of going through the ring, see host/hostsketch.cpp
+void hostTrace(uint8_t lEvent, uint8_t lArg1, uint8_t lArg2);
+#define TRACE(event, arg1, arg2) hostTrace((event), (arg1), (arg2))
+#define TRACE_TICK() do {} while(0)
+
+#elif TRACE_ENABLED && !defined(TRACE_DECODER)
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+extern TraceRecord gTraceBuffer[TRACE_BUFFER_LENGTH];
+extern uint8_t gTraceHead;
+extern uint8_t gTraceCount;
+extern uint8_t gTraceLost;
+extern volatile uint16_t gTraceTick;
+extern bool gTraceFlushRequested;
+
+inline void traceRecord(uint8_t lEvent, uint8_t lArg1, uint8_t lArg2)
+{
+    TraceRecord &lRecord = gTraceBuffer[gTraceHead];
+    // gTraceTick is two bytes and the ISR moves it, so read the time with interrupts off.
+    // a compare match that lands meanwhile has already cleared TCNT0 but isn't in gTraceTick yet
+    uint8_t lOldSreg = SREG;
+    cli();
+    uint8_t lSubTick = TCNT0;
+    uint16_t lTick = gTraceTick;
+    if((TIFR0 & (1 << OCF0A)) && lSubTick < OCR0A)
+    {
+        lTick++;
+    }
+    SREG = lOldSreg;
+    lRecord.tick = lTick;
+    lRecord.subTick = lSubTick;
+    lRecord.event = lEvent;
+    lRecord.arg1 = lArg1;
+    lRecord.arg2 = lArg2;
+    gTraceHead = (gTraceHead + 1) & (TRACE_BUFFER_LENGTH - 1);
+    if(gTraceCount < TRACE_BUFFER_LENGTH)
+    {
+        gTraceCount++;
+    }
+    else if(gTraceLost < 0xFF)
+    {
+        gTraceLost++;
+    }
+}
+
+void traceFlush();
+
+#define TRACE(event, arg1, arg2) traceRecord((event), (arg1), (arg2))
+#define TRACE_TICK() (gTraceTick++)
+
+#else
+
+#define TRACE(event, arg1, arg2) do {} while(0)
+#define TRACE_TICK() do {} while(0)
+
+#endif // HOST_BUILD / TRACE_ENABLED
+
+#endif // TRACE_H
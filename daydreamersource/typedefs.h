@@ -15,12 +15,31 @@
 
 #ifndef TYPEDEFS_H
 #define TYPEDEFS_H
+
+#define NUM_VOICES 6
+#define NUM_PARAMS 8
+#define NUM_MOD_SOURCES 5
+#define NUM_MOD_DESTINATIONS 4
+
 //1 oscillator mono, 2 oscillator mono, 3 oscillator mono, 6 oscillator mono, 1 oscillator poly (6 note), 2 oscillator poly (3 note), 3 oscillator poly (2 note)
-typedef enum {MONO_1, MONO_2, MONO_3, MONO_6, POLY_1, POLY_2, POLY_3} POLYPHONY;  
+//and 1 oscillator poly with a voice per MPE member channel, which the switches never pick (see mpezone.h)
+typedef enum {MONO_1, MONO_2, MONO_3, MONO_6, POLY_1, POLY_2, POLY_3, POLY_MPE} POLYPHONY;  
+
+typedef enum {STATUS, DATA1, DATA2, SYSEX, DONE} PARSE_STATUSES;
+typedef enum {NOTE_ON, NOTE_OFF, PITCH_BEND, CONTROL, PROGRAM_CHANGE, CHANNEL_PRESSURE, SYSTEM_EXCLUSIVE, UNDEFINED_STATUS} STATUSES;
+typedef enum {MODULATION, SUSTAIN_PEDAL, RPN_MSB, RPN_LSB, NRPN_SELECT, DATA_ENTRY, UNDEFINED_CONTROL} CONTROL_STATUSES;
+
+//sound parameters and where each one gets its value from, see parametersources.h. NUM_PARAMS of them
+typedef enum {PARAM_ATTACK, PARAM_DECAY, PARAM_SUSTAIN, PARAM_RELEASE, PARAM_GLIDE, PARAM_LFO_FREQ, PARAM_LFO_VCF, PARAM_LFO_VCO} PARAMETERS;
+typedef enum {SOURCE_KNOB, SOURCE_CC, SOURCE_PRESET} PARAMETER_SOURCES;
+
+//modulation matrix, see modmatrix.h. NUM_MOD_SOURCES and NUM_MOD_DESTINATIONS of them
+typedef enum {MOD_SRC_LFO, MOD_SRC_WHEEL, MOD_SRC_VELOCITY, MOD_SRC_ENVELOPE, MOD_SRC_PRESSURE} MOD_SOURCES;
+typedef enum {MOD_DST_PITCH, MOD_DST_VCA, MOD_DST_LPF, MOD_DST_LFO_RATE} MOD_DESTINATIONS;
 
-typedef enum {STATUS, DATA1, DATA2, DONE} PARSE_STATUSES;
-typedef enum {NOTE_ON, NOTE_OFF, PITCH_BEND, CONTROL, UNDEFINED_STATUS} STATUSES;
-typedef enum {MODULATION, SUSTAIN_PEDAL, UNDEFINED_CONTROL} CONTROL_STATUSES;
+//see idlemonitor.h
+typedef enum {IDLE_ACTIVE, IDLE_QUIESCENT} IDLE_STATES;
+typedef enum {IDLE_WAKE_MIDI, IDLE_WAKE_PANEL} IDLE_WAKE_REASONS;
 
 typedef enum {ATTACK_STATE, DECAY_STATE, SUSTAIN_STATE, RELEASE_STATE, OFF_STATE} ADSR_STATUSES;
 
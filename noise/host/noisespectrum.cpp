@@ -0,0 +1,264 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it
+*   under the terms of the GNU General Public License as published by the Free Software Foundation,
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/*
+ *  host build of the noise generator
+ *  runs the same noiselfsr.h as the ATTINY45 for every mode and clock rate, then reports
+ *  - octave band levels and the slope in dB/octave between the slowest pink row and a quarter of the clock
+ *    (white is ~0, pink should be ~-3)
+ *  - how many bits per second the step functions manage on this machine
+ *
+ *  build:  g++ -O2 -o noisespectrum noise/host/noisespectrum.cpp
+ *  run:    ./noisespectrum [seconds per setting] [raw output file]
+ *          the raw file gets the white 100 kHz bitstream, one byte per bit, for looking at in an audio editor
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <complex>
+#include <vector>
+#include "../noiselfsr.h"
+
+#define NOISE_F_CPU 8000000.0
+#define ANALYSIS_RATE 400000.0  //every clock rate divides into this, 100 kHz holds each bit for 4 samples
+#define FFT_SIZE 16384
+#define NUM_BANDS 9             //octave bands from 125 Hz up to 32 kHz centres
+#define BAND_LOWEST 125.0
+
+typedef std::complex<double> Complex;
+
+double noiseRateHz(NOISE_RATES lRate)
+{
+    return NOISE_F_CPU / (1 << (gNoiseRates[lRate].prescaleBits - 1)) / (gNoiseRates[lRate].top + 1);
+}
+
+void fft(std::vector<Complex> &lData)
+{
+    size_t lSize = lData.size();
+    for(size_t i = 1, j = 0; i < lSize; i++)
+    {
+        size_t lBit = lSize >> 1;
+        for(; j & lBit; lBit >>= 1)
+        {
+            j ^= lBit;
+        }
+        j ^= lBit;
+        if(i < j)
+        {
+            std::swap(lData[i], lData[j]);
+        }
+    }
+    for(size_t lLength = 2; lLength <= lSize; lLength <<= 1)
+    {
+        double lAngle = -2 * M_PI / lLength;
+        Complex lStep(cos(lAngle), sin(lAngle));
+        for(size_t i = 0; i < lSize; i += lLength)
+        {
+            Complex w(1);
+            for(size_t j = 0; j < lLength / 2; j++)
+            {
+                Complex u = lData[i + j];
+                Complex v = lData[i + j + lLength / 2] * w;
+                lData[i + j] = u + v;
+                lData[i + j + lLength / 2] = u - v;
+                w *= lStep;
+            }
+        }
+    }
+}
+
+// generates lSeconds of noise at the given rate, resampled to ANALYSIS_RATE. output is -1 to 1
+std::vector<float> generate(NOISE_MODES lMode, NOISE_RATES lRate, double lSeconds)
+{
+    uint32_t lReg = NOISE_LFSR_SEED;
+    PinkState lPink = {0, 0, 0};
+    int lHold = (int)(ANALYSIS_RATE / noiseRateHz(lRate) + 0.5);
+    long lBits = (long)(lSeconds * noiseRateHz(lRate));
+    std::vector<float> lOut;
+    lOut.reserve(lBits * lHold);
+    for(long i = 0; i < lBits; i++)
+    {
+        float lValue;
+        if(lMode == NOISE_PINK)
+        {
+            lValue = noisePinkStep(lPink, lReg) / (float)((NOISE_PINK_ROWS + 1) * NOISE_PINK_SCALE) * 2 - 1;
+        }
+        else
+        {
+            lValue = noiseLfsrStep(lReg) ? 1.0f : -1.0f;
+        }
+        for(int h = 0; h < lHold; h++)
+        {
+            lOut.push_back(lValue);
+        }
+    }
+    return lOut;
+}
+
+// welch averaged power spectral density, hann window
+std::vector<double> spectrum(const std::vector<float> &lSignal)
+{
+    std::vector<double> lPsd(FFT_SIZE / 2, 0.0);
+    std::vector<Complex> lFrame(FFT_SIZE);
+    int lFrames = 0;
+    for(size_t lStart = 0; lStart + FFT_SIZE <= lSignal.size(); lStart += FFT_SIZE / 2)
+    {
+        double lMean = 0;
+        for(int i = 0; i < FFT_SIZE; i++)
+        {
+            lMean += lSignal[lStart + i];
+        }
+        lMean /= FFT_SIZE;
+        for(int i = 0; i < FFT_SIZE; i++)
+        {
+            double lWindow = 0.5 - 0.5 * cos(2 * M_PI * i / (FFT_SIZE - 1));
+            lFrame[i] = Complex((lSignal[lStart + i] - lMean) * lWindow, 0);
+        }
+        fft(lFrame);
+        for(int i = 0; i < FFT_SIZE / 2; i++)
+        {
+            lPsd[i] += std::norm(lFrame[i]);
+        }
+        lFrames++;
+    }
+    for(size_t i = 0; i < lPsd.size(); i++)
+    {
+        lPsd[i] /= (lFrames ? lFrames : 1);
+    }
+    return lPsd;
+}
+
+// average density in each octave band, in dB
+void octaveBands(const std::vector<double> &lPsd, double lBandDb[NUM_BANDS])
+{
+    double lBinHz = ANALYSIS_RATE / FFT_SIZE;
+    for(int b = 0; b < NUM_BANDS; b++)
+    {
+        double lCentre = BAND_LOWEST * (1 << b);
+        int lLow = (int)(lCentre / M_SQRT2 / lBinHz);
+        int lHigh = (int)(lCentre * M_SQRT2 / lBinHz);
+        lLow = lLow < 1 ? 1 : lLow;
+        double lSum = 0;
+        for(int i = lLow; i < lHigh; i++)
+        {
+            lSum += lPsd[i];
+        }
+        lBandDb[b] = 10 * log10(lSum / (lHigh - lLow) + 1e-30);
+    }
+}
+
+// least squares slope of band level against octave number.
+// only uses bands above the slowest pink row (rate / 2^NOISE_PINK_ROWS) and below a quarter of the clock rate
+double slopePerOctave(const double lBandDb[NUM_BANDS], double lRateHz)
+{
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    int n = 0;
+    for(int b = 0; b < NUM_BANDS; b++)
+    {
+        double lCentre = BAND_LOWEST * (1 << b);
+        if(lCentre < lRateHz / (1 << NOISE_PINK_ROWS) || lCentre > lRateHz / 4)
+        {
+            continue;
+        }
+        sx += b;
+        sy += lBandDb[b];
+        sxx += b * b;
+        sxy += b * lBandDb[b];
+        n++;
+    }
+    if(n < 2)
+    {
+        return 0;
+    }
+    return (n * sxy - sx * sy) / (n * sxx - sx * sx);
+}
+
+double secondsSince(clock_t lStart)
+{
+    return (double)(clock() - lStart) / CLOCKS_PER_SEC;
+}
+
+void throughput()
+{
+    const long lSteps = 50000000;
+    uint32_t lReg = NOISE_LFSR_SEED;
+    PinkState lPink = {0, 0, 0};
+    volatile uint32_t lSink = 0;
+
+    clock_t lStart = clock();
+    for(long i = 0; i < lSteps; i++)
+    {
+        lSink += noiseLfsrStep(lReg);
+    }
+    double lWhiteSeconds = secondsSince(lStart);
+
+    lStart = clock();
+    for(long i = 0; i < lSteps; i++)
+    {
+        lSink += noisePinkStep(lPink, lReg);
+    }
+    double lPinkSeconds = secondsSince(lStart);
+
+    printf("throughput (host):  white %.1f Mbit/s   pink %.1f Msample/s\n",
+        lSteps / lWhiteSeconds / 1e6, lSteps / lPinkSeconds / 1e6);
+}
+
+int main(int argc, char **argv)
+{
+    double lSeconds = argc > 1 ? atof(argv[1]) : 2.0;
+    const char *lRawPath = argc > 2 ? argv[2] : NULL;
+    const char *lModeNames[] = {"white", "pink"};
+
+    throughput();
+    printf("\n%-6s %9s %7s ", "mode", "rate Hz", "cyc/bit");
+    for(int b = 0; b < NUM_BANDS; b++)
+    {
+        printf("%7.0f", BAND_LOWEST * (1 << b));
+    }
+    printf("  dB/oct\n");
+
+    for(int m = NOISE_WHITE; m <= NOISE_PINK; m++)
+    {
+        for(int r = 0; r < NOISE_RATE_COUNT; r++)
+        {
+            NOISE_RATES lRate = static_cast<NOISE_RATES>(r);
+            std::vector<float> lSignal = generate(static_cast<NOISE_MODES>(m), lRate, lSeconds);
+            if(lRawPath && m == NOISE_WHITE && r == NOISE_RATE_100K)
+            {
+                FILE *lRaw = fopen(lRawPath, "wb");
+                if(lRaw)
+                {
+                    for(size_t i = 0; i < lSignal.size(); i += 4)
+                    {
+                        fputc(lSignal[i] > 0, lRaw);
+                    }
+                    fclose(lRaw);
+                }
+            }
+            double lBandDb[NUM_BANDS];
+            octaveBands(spectrum(lSignal), lBandDb);
+            double lRateHz = noiseRateHz(lRate);
+            printf("%-6s %9.0f %7.0f ", lModeNames[m], lRateHz, NOISE_F_CPU / lRateHz);
+            for(int b = 0; b < NUM_BANDS; b++)
+            {
+                printf("%7.1f", lBandDb[b] - lBandDb[0]);
+            }
+            printf("  %6.2f\n", slopePerOctave(lBandDb, lRateHz));
+        }
+    }
+    return 0;
+}
@@ -1,15 +1,15 @@
 /*
 *   This file is part of daydreamer_synth1.
 *
-*   daydreamer_synth1 is free software: you can redistribute it and/or modify it 
-*   under the terms of the GNU General Public License as published by the Free Software Foundation, 
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it
+*   under the terms of the GNU General Public License as published by the Free Software Foundation,
 *   either version 3 of the License, or (at your option) any later version.
 *
-*   daydreamer_synth1 is distributed in the hope that it will be useful, 
-*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS 
+*   daydreamer_synth1 is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
 *   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
 *
-*   You should have received a copy of the GNU General Public License along with 
+*   You should have received a copy of the GNU General Public License along with
 *   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
 */
 
@@ -17,7 +17,19 @@
 // burn bootloader for 8MHz
 // arduino IDE 2.2.1
 
-#define audioPin 0
+// the bits are clocked out of the TIMER1 compare interrupt, so the rate no longer depends on how long loop() takes.
+// white: the LFSR bit is written straight to PORTB.
+// pink: TIMER0 runs fast PWM on OC0A (same pin) at 31.25 kHz and the ISR writes the Voss-McCartney sum into OCR0A.
+// noise/host has a host build of the same maths for checking the spectrum of each setting without a scope.
+
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include "noiselfsr.h"
+
+#define audioPin 0      //PB0, also OC0A for pink mode
+
+#define NOISE_MODE NOISE_WHITE
+#define NOISE_RATE NOISE_RATE_100K  //pink does more work per bit, keep it at NOISE_RATE_50K or slower
 
 /* NOISE */
 
@@ -25,41 +37,91 @@ class noise
 {
 public:
     noise(int noise_pin);
-    void generate(int noise_color);
+    void begin(NOISE_MODES noise_mode, NOISE_RATES noise_rate);
+    void setRate(NOISE_RATES noise_rate);
+    void generate();
 private:
-    int _pin;
-	int _color;
-	unsigned long int reg;
-	unsigned long int newr;
-	unsigned char lobit;
-	unsigned char b31, b29, b25, b24;
+    NOISE_MODES _mode;
+    uint32_t reg;
+    PinkState _pink;
 };
 
 noise::noise(int noise_pin)
 {
 	pinMode(noise_pin, OUTPUT);
-	_pin = noise_pin;
-	reg = 0x55aa55aaL; //The seed for the bitstream. 
-	
+	_mode = NOISE_WHITE;
+	reg = NOISE_LFSR_SEED;
+	_pink.counter = 0;
+	_pink.rows = 0;
+	_pink.sum = 0;
+}
+
+void noise::begin(NOISE_MODES noise_mode, NOISE_RATES noise_rate)
+{
+	cli();
+	_mode = noise_mode;
+
+	// timer0 belongs to us now. millis() and delay() will not work
+	TIMSK &= ~(1 << TOIE0);
+	if(_mode == NOISE_PINK)
+	{
+		TCCR0A = (1 << COM0A1) | (1 << WGM01) | (1 << WGM00);	//fast PWM, clear OC0A on compare match
+		TCCR0B = (1 << CS00);									//no prescaler, 8MHz / 256 = 31.25 kHz carrier
+		OCR0A = 0;
+	}
+	else
+	{
+		TCCR0A = 0;
+		TCCR0B = 0;
+	}
+
+	setRate(noise_rate);
+	TIMSK |= (1 << OCIE1A);
+	sei();
 }
-void noise::generate(int noise_color)
+
+void noise::setRate(NOISE_RATES noise_rate)
+{
+	// CTC on OCR1C. the compare A interrupt fires at the same count so it runs once per period
+	uint8_t oldSREG = SREG;
+	cli();
+	TCCR1 = (1 << CTC1) | gNoiseRates[noise_rate].prescaleBits;
+	OCR1C = gNoiseRates[noise_rate].top;
+	OCR1A = gNoiseRates[noise_rate].top;
+	TCNT1 = 0;
+	SREG = oldSREG;
+}
+
+// this is the ISR body. keep it short, at 100 kHz there are only 80 cycles per bit
+void noise::generate()
 {
-  b31 = (reg & (1L << 31)) >> 31;
-	b29 = (reg & (1L << 29)) >> 29;
-	b25 = (reg & (1L << 25)) >> 25;
-	b24 = (reg & (1L << 24)) >> 24;
-	lobit = b31 ^ b29 ^ b25 ^ b24;
-	newr = (reg << 1) | lobit;
-	reg = newr;
-	digitalWrite (_pin, reg & 1);
-	delayMicroseconds (noise_color);
+	if(_mode == NOISE_PINK)
+	{
+		OCR0A = noisePinkStep(_pink, reg);
+	}
+	else if(noiseLfsrStep(reg))
+	{
+		PORTB |= (1 << audioPin);
+	}
+	else
+	{
+		PORTB &= ~(1 << audioPin);
+	}
 };
 
 noise noise(audioPin);
 
+ISR(TIMER1_COMPA_vect)
+{
+	noise.generate();
+}
+
 void setup() {
+  noise.begin(NOISE_MODE, NOISE_RATE);
+  set_sleep_mode(SLEEP_MODE_IDLE);
 }
 
 void loop() {
-  noise.generate(0);
-}
\ No newline at end of file
+  // nothing to do between interrupts. idle sleep keeps the timers running and the CPU quiet
+  sleep_mode();
+}
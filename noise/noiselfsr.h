@@ -0,0 +1,110 @@
+/*
+*   This file is part of daydreamer_synth1.
+*
+*   daydreamer_synth1 is free software: you can redistribute it and/or modify it
+*   under the terms of the GNU General Public License as published by the Free Software Foundation,
+*   either version 3 of the License, or (at your option) any later version.
+*
+*   daydreamer_synth1 is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+*   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License along with
+*   daydreamer_synth1. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/*
+ *  noise bitstream generation
+ *  shared between noise.ino (ATTINY45) and the host tool in noise/host so both run the same maths.
+ *  nothing in here touches hardware.
+ *
+ *  the LFSR is in Galois form: one shift and one conditional xor per bit,
+ *  instead of pulling four tap bits out separately like the old Fibonacci version did.
+ *  taps 32, 22, 2, 1 is a maximal length polynomial, so the sequence repeats every 2^32 - 1 bits.
+ */
+
+#ifndef NOISELFSR_H
+#define NOISELFSR_H
+
+#include <stdint.h>
+
+#define NOISE_LFSR_SEED 0x55aa55aaUL    //The seed for the bitstream. never 0 or the register locks up
+#define NOISE_LFSR_TAPS 0x80200003UL    //x^32 + x^22 + x^2 + x^1 + 1
+
+#define NOISE_PINK_ROWS 7               //octaves of the Voss-McCartney pink filter. each row holds half as long as the one before it
+#define NOISE_PINK_SCALE 31             //(NOISE_PINK_ROWS + 1) * 31 = 248, fits in the 8 bit PWM compare register
+
+typedef enum {NOISE_WHITE, NOISE_PINK} NOISE_MODES;
+
+// timer1 clock rates for the noise colour. a slower clock holds each bit longer which rolls off the highs.
+// timer1 on the ATTINY45 runs at F_CPU / 2^(prescaleBits - 1) and clears at top, so the bit rate is that / (top + 1)
+typedef enum {NOISE_RATE_100K, NOISE_RATE_50K, NOISE_RATE_25K, NOISE_RATE_12K, NOISE_RATE_6K, NOISE_RATE_3K, NOISE_RATE_COUNT} NOISE_RATES;
+
+typedef struct NoiseRate
+{
+    uint8_t prescaleBits;   //CS13:CS10 of TCCR1
+    uint8_t top;            //OCR1C
+} NoiseRate;
+
+const NoiseRate gNoiseRates[NOISE_RATE_COUNT] = {
+    {4, 9},     // 8MHz / 8 / 10   = 100 kHz
+    {4, 19},    // 8MHz / 8 / 20   = 50 kHz
+    {4, 39},    // 8MHz / 8 / 40   = 25 kHz
+    {4, 79},    // 8MHz / 8 / 80   = 12.5 kHz
+    {4, 159},   // 8MHz / 8 / 160  = 6.25 kHz
+    {5, 159}    // 8MHz / 16 / 160 = 3.125 kHz
+};
+
+typedef struct PinkState
+{
+    uint8_t counter;    //which row to refresh is picked from the trailing zeros of this
+    uint8_t rows;       //one bit per octave row
+    uint8_t sum;        //number of rows that are high, kept up to date so we never have to count them
+} PinkState;
+
+// steps the register once and returns the new output bit
+inline uint8_t noiseLfsrStep(uint32_t &lReg)
+{
+    uint8_t lLobit = lReg & 1;
+    lReg >>= 1;
+    if(lLobit)
+    {
+        lReg ^= NOISE_LFSR_TAPS;
+    }
+    return lLobit;
+}
+
+// Voss-McCartney: row k gets a new bit every 2^(k+1) steps, on top of a fresh white bit every step.
+// summing octave spaced sample and holds gives close to -3dB/octave. returns the PWM duty (0 - 248)
+inline uint8_t noisePinkStep(PinkState &lPink, uint32_t &lReg)
+{
+    uint8_t lWhiteBit = noiseLfsrStep(lReg);
+
+    lPink.counter++;
+    uint8_t lCounter = lPink.counter;
+    uint8_t lRow = 0;
+    // find the lowest set bit. counter == 0 happens once per 256 steps and refreshes nothing
+    while(lCounter && !(lCounter & 1) && lRow < NOISE_PINK_ROWS - 1)
+    {
+        lCounter >>= 1;
+        lRow++;
+    }
+    if(lCounter)
+    {
+        uint8_t lRowMask = 1 << lRow;
+        uint8_t lNewBit = noiseLfsrStep(lReg);
+        if((lPink.rows & lRowMask) && !lNewBit)
+        {
+            lPink.rows &= ~lRowMask;
+            lPink.sum--;
+        }
+        else if(!(lPink.rows & lRowMask) && lNewBit)
+        {
+            lPink.rows |= lRowMask;
+            lPink.sum++;
+        }
+    }
+    return (lPink.sum + lWhiteBit) * NOISE_PINK_SCALE;
+}
+
+#endif // NOISELFSR_H